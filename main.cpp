@@ -12,6 +12,7 @@
 #include "src/lib/fps_meter.hpp"
 #include "src/lib/camera.hpp"
 #include "src/lib/world.hpp"
+#include "src/lib/asset_registry.hpp"
 #include "src/lib/audio.hpp"
 #include "src/lib/video.hpp"
 
@@ -52,7 +53,10 @@ int main()
 
         if (glfwWindowShouldClose(Renderer::window))
             break;
-        
+
+        // Streams in what the loader threads finished, within a fixed time budget
+        AssetRegistry::update();
+
         World::calculate(delta);
         Renderer::execute(*World::material);
         GUI::render();
@@ -7,14 +7,20 @@ in vec3 aColor; // any additional attributes are optional, any data type, etc.
 
 out vec3 color; // optional output attribute
 
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec3 viewPos;
+    float time;
+};
+
 uniform mat4 transform;
-uniform mat4 projection;
-uniform mat4 view;
 
 void main()
 {
     // Outputs the positions/coordinates of all vertices, MUST WRITE
-    gl_Position = projection * view * transform * vec4(aPos, 1.0f);
+    gl_Position = viewProjection * transform * vec4(aPos, 1.0f);
     
     color = aColor; // copy color to output
 }
@@ -0,0 +1,26 @@
+#version 460 core
+
+// Resolves weighted blended transparency over the opaque image,
+// blended with GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA
+uniform sampler2D accumulation;
+uniform sampler2D revealage;
+
+out vec4 FragColor;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+
+    // Nothing transparent covers this pixel
+    float reveal = texelFetch(revealage, texel, 0).r;
+    if (reveal >= 1.0) discard;
+
+    vec4 accumulated = texelFetch(accumulation, texel, 0);
+
+    // Too many heavy fragments overflow half floats, the average color still holds
+    if (isinf(max(max(abs(accumulated.r), abs(accumulated.g)), abs(accumulated.b)))) {
+        accumulated.rgb = vec3(accumulated.a);
+    }
+
+    FragColor = vec4(accumulated.rgb / max(accumulated.a, 1e-5), reveal);
+}
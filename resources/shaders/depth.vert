@@ -0,0 +1,28 @@
+#version 460 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 3) in mat4 transform; // per instance, see InstanceLayout
+
+// Per frame camera, filled once by Renderer::beginFrame (std140, see CameraBlock)
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec3 viewPos;
+    float time;
+};
+
+// Vertex format of the mesh, see vertex_layout.hpp
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
+// The color pass tests against this depth with GL_EQUAL, both compute it the same way
+invariant gl_Position;
+
+void main()
+{
+    vec3 position = positionOffset + aPos * positionScale;
+    vec3 worldPos = vec3(transform * vec4(position, 1.0));
+
+    gl_Position = viewProjection * vec4(worldPos, 1.0);
+}
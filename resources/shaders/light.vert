@@ -1,11 +1,17 @@
 #version 460 core
 layout (location = 0) in vec3 aPos;
 
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec3 viewPos;
+    float time;
+};
+
 uniform mat4 transform;
-uniform mat4 view;
-uniform mat4 projection;
 
 void main()
 {
-	gl_Position = projection * view * transform * vec4(aPos, 1.0);
+	gl_Position = viewProjection * transform * vec4(aPos, 1.0);
 }
\ No newline at end of file
@@ -3,16 +3,21 @@
 in vec3 FragPos;  
 in vec3 Normal; 
 in vec2 TexCoord;
-out vec4 FragColor;
 
-#define MAX_AMBIENT_LIGHTS 8
-#define MAX_POINTS_LIGHTS 16
-#define MAX_DIRECTIONAL_LIGHTS 16
-#define MAX_SPOT_LIGHTS 8
+layout (location = 0) out vec4 FragColor;
+#ifdef WEIGHTED_BLENDED
+layout (location = 1) out float Revealage;
+#endif
+
+/*
+    Compiled per material by ShaderVariants.
+    - TEXTURED takes the colors from the material texture instead of the material constants
+    - WEIGHTED_BLENDED writes the weighted blended transparency targets, see Renderer
+    - MAX_*_LIGHTS and CLUSTER_X/Y/Z come from LightSystem::defines
+*/
 
 struct Texture {
     sampler2D textureUnit;
-    int isTextured;
     vec3 scale;
 };
 
@@ -63,21 +68,53 @@ struct DirectionaLight {
     vec3 diffuse;
     vec3 specular;
 };  
+
+// Point (type 0) or spot light, ambient, diffuse and specular carry the attenuation terms in w
+struct ClusterLight {
+    vec4 positionRadius;
+    vec4 directionType;
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
+    vec4 cone; // cutOff, outerCutOff
+};
   
-uniform vec3 viewPos;
+// Per frame camera, filled once by Renderer::beginFrame (std140, see CameraBlock)
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec3 viewPos;
+    float time;
+};
+
 uniform Material material;
 
-uniform AmbientLight ambientLights[MAX_AMBIENT_LIGHTS];
-uniform PointLight pointLights[MAX_POINTS_LIGHTS];
-uniform SpotLight spotLights[MAX_SPOT_LIGHTS];
-uniform DirectionaLight directionalLights[MAX_DIRECTIONAL_LIGHTS];
+// Every light of the scene, uploaded by LightSystem where it changed (std140, see LightsBlock)
+layout (std140) uniform Lights {
+    ivec4 lightCounts;  // ambient, directional, point and spot
+    vec4 clusterDepth;  // slice of a view depth d is log(d) * x + y
+    AmbientLight ambientLights[MAX_AMBIENT_LIGHTS];
+    DirectionaLight directionalLights[MAX_DIRECTIONAL_LIGHTS];
+    ClusterLight lights[MAX_LIGHTS];
+};
+
+uniform usamplerBuffer lightClusters; // offset and count into lightIndices per cluster
+uniform usamplerBuffer lightIndices;
+
+// Lights end at the radius they were binned with, fading out instead of cutting off
+float rangeWindow(float distance, float radius) {
+    float ratio = distance / radius;
+    float fade = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+    return fade * fade;
+}
 
 vec3 getAmbientLight(AmbientLight light, Material material) {
-    if (material.texture.isTextured == 1) {
-        return light.color * light.intensity * texture(material.texture.textureUnit, TexCoord).rgb;
-    } else {
-        return light.color * light.intensity * material.diffuse;
-    }
+#ifdef TEXTURED
+    return light.color * light.intensity * texture(material.texture.textureUnit, TexCoord).rgb;
+#else
+    return light.color * light.intensity * material.diffuse;
+#endif
 }
 
 vec3 getPointLight(PointLight light, Material material, vec3 normal, vec3 fragPos, vec3 viewDir, vec2 TexCoord) {
@@ -96,15 +133,16 @@ vec3 getPointLight(PointLight light, Material material, vec3 normal, vec3 fragPo
 
     vec3 ambient, diffuse, specular;
 
-    if (material.texture.isTextured == 1) {
-        ambient = light.ambient * texture(material.texture.textureUnit, TexCoord).rgb;
-        diffuse = light.diffuse * diff * texture(material.texture.textureUnit, TexCoord).rgb;
-        specular = light.specular * spec * texture(material.texture.textureUnit, TexCoord).rgb;
-    } else {
-        ambient = light.ambient * material.diffuse;
-        diffuse = light.diffuse * diff * material.diffuse;
-        specular = light.specular * spec * material.specular;
-    }
+#ifdef TEXTURED
+    vec3 color = texture(material.texture.textureUnit, TexCoord).rgb;
+    ambient = light.ambient * color;
+    diffuse = light.diffuse * diff * color;
+    specular = light.specular * spec * color;
+#else
+    ambient = light.ambient * material.diffuse;
+    diffuse = light.diffuse * diff * material.diffuse;
+    specular = light.specular * spec * material.specular;
+#endif
 
     ambient *= attenuation;
     diffuse *= attenuation;
@@ -133,15 +171,16 @@ vec3 getSpotLight(SpotLight light, Material material, vec3 normal, vec3 fragPos,
     
     vec3 ambient, diffuse, specular;
 
-    if (material.texture.isTextured == 1) {
-        ambient = light.ambient * texture(material.texture.textureUnit, TexCoord).rgb;
-        diffuse = light.diffuse * diff * texture(material.texture.textureUnit, TexCoord).rgb;
-        specular = light.specular * spec * texture(material.texture.textureUnit, TexCoord).rgb;
-    } else {
-        ambient = light.ambient * material.diffuse;
-        diffuse = light.diffuse * diff * material.diffuse;
-        specular = light.specular * spec * material.specular;
-    }
+#ifdef TEXTURED
+    vec3 color = texture(material.texture.textureUnit, TexCoord).rgb;
+    ambient = light.ambient * color;
+    diffuse = light.diffuse * diff * color;
+    specular = light.specular * spec * color;
+#else
+    ambient = light.ambient * material.diffuse;
+    diffuse = light.diffuse * diff * material.diffuse;
+    specular = light.specular * spec * material.specular;
+#endif
 
     ambient *= attenuation * intensity;
     diffuse *= attenuation * intensity;
@@ -159,13 +198,14 @@ vec3 getDirectionaLight(DirectionaLight light, Material material, vec3 normal, v
     
     vec3 ambient, diffuse;
 
-    if (material.texture.isTextured == 1) {
-        ambient = light.ambient * texture(material.texture.textureUnit, TexCoord).rgb;
-        diffuse = light.diffuse * diff * texture(material.texture.textureUnit, TexCoord).rgb;
-    } else {
-        ambient = light.ambient * material.diffuse;
-        diffuse = light.diffuse * diff * material.diffuse;
-    }
+#ifdef TEXTURED
+    vec3 color = texture(material.texture.textureUnit, TexCoord).rgb;
+    ambient = light.ambient * color;
+    diffuse = light.diffuse * diff * color;
+#else
+    ambient = light.ambient * material.diffuse;
+    diffuse = light.diffuse * diff * material.diffuse;
+#endif
     
     return (ambient + diffuse);
 }
@@ -181,36 +221,56 @@ void main()
 
     vec3 viewDir = normalize(viewPos - FragPos);
 
-    for (int i = 0; i < MAX_AMBIENT_LIGHTS; i++) {
+    for (int i = 0; i < lightCounts.x; i++) {
         // if light is not shining anything, skip it.
         if (ambientLights[i].color == vec3(0.0f)) continue;
 
         accumulator += getAmbientLight(ambientLights[i], material);
     }
 
-    for (int i = 0; i < MAX_DIRECTIONAL_LIGHTS; i++) {
+    for (int i = 0; i < lightCounts.y; i++) {
         // if light is not shining anything, skip it.
         if (directionalLights[i].diffuse == vec3(0.0f)) continue;
 
         accumulator += getDirectionaLight(directionalLights[i], material, norm, viewDir, TexCoord);
     }
 
-    for (int i = 0; i < MAX_SPOT_LIGHTS; i++) {
-        // if light is not shining anything, skip it.
-        if (spotLights[i].diffuse == vec3(0.0f)) continue;
-
-        accumulator += getSpotLight(spotLights[i], material, norm, FragPos, viewDir, TexCoord);
-    }
-
-    for (int i = 0; i < MAX_POINTS_LIGHTS; i++) {
-        // if light is not shining anything, skip it.
-        if (pointLights[i].diffuse == vec3(0.0f)) continue;
-
-        accumulator += getPointLight(pointLights[i], material, norm, FragPos, viewDir, TexCoord);
+    // Only the point and spot lights binned into the cluster of this fragment
+    vec4 clip = viewProjection * vec4(FragPos, 1.0);
+    vec2 tile = clamp(clip.xy / clip.w * 0.5 + 0.5, 0.0, 0.9999) * vec2(CLUSTER_X, CLUSTER_Y);
+    float depth = max(-(view * vec4(FragPos, 1.0)).z, 1e-4);
+    int slice = clamp(int(floor(log(depth) * clusterDepth.x + clusterDepth.y)), 0, CLUSTER_Z - 1);
+    uvec2 range = texelFetch(lightClusters, (slice * CLUSTER_Y + int(tile.y)) * CLUSTER_X + int(tile.x)).xy;
+
+    for (uint i = 0u; i < range.y; i++) {
+        ClusterLight clustered = lights[texelFetch(lightIndices, int(range.x + i)).r];
+
+        float window = rangeWindow(length(clustered.positionRadius.xyz - FragPos), clustered.positionRadius.w);
+        if (window <= 0.0) continue;
+
+        vec4 ambient = clustered.ambient, diffuse = clustered.diffuse, specular = clustered.specular;
+
+        if (clustered.directionType.w == 0.0) {
+            PointLight light = PointLight(clustered.positionRadius.xyz, ambient.rgb, diffuse.rgb, specular.rgb, ambient.w, diffuse.w, specular.w);
+            accumulator += getPointLight(light, material, norm, FragPos, viewDir, TexCoord) * window;
+        } else {
+            SpotLight light = SpotLight(clustered.positionRadius.xyz, clustered.directionType.xyz, clustered.cone.x, clustered.cone.y,
+                ambient.w, diffuse.w, specular.w, ambient.rgb, diffuse.rgb, specular.rgb);
+            accumulator += getSpotLight(light, material, norm, FragPos, viewDir, TexCoord) * window;
+        }
     }
 
     // Gamma Correction
     accumulator = pow(accumulator, vec3(1.0/2.2));
-    
+
+#ifdef WEIGHTED_BLENDED
+    // McGuire and Bavoil 2013, nearer and more opaque fragments weigh more
+    float alpha = material.transparency;
+    float weight = clamp(pow(min(1.0, alpha * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - gl_FragCoord.z * 0.9, 3.0), 1e-2, 3e3);
+
+    FragColor = vec4(accumulator * alpha, alpha) * weight;
+    Revealage = alpha;
+#else
     FragColor = vec4(accumulator, material.transparency);
+#endif
 } 
\ No newline at end of file
@@ -1,8 +1,9 @@
 #version 460 core
 
+// Compiled per material by ShaderVariants, TEXTURED scales the texture coordinates
+
 struct Texture {
     sampler2D textureUnit;
-    int isTextured;
     vec3 scale;
 };
 
@@ -16,28 +17,55 @@ struct Material {
 }; 
 
 layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
+layout (location = 1) in vec3 aNormal; // only xy with octahedral normals
 layout (location = 2) in vec2 aTexCoord;
+layout (location = 3) in mat4 transform; // per instance, see InstanceLayout
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoord;
 
-uniform mat4 transform;
-uniform mat4 view;
-uniform mat4 projection;
+// Per frame camera, filled once by Renderer::beginFrame (std140, see CameraBlock)
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec3 viewPos;
+    float time;
+};
+
 uniform Material material;
 
+// Vertex format of the mesh, see vertex_layout.hpp
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+uniform bool octNormals;
+
+// Must match the depth pre-pass exactly, see depth.vert
+invariant gl_Position;
+
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
 void main()
 {
-    FragPos = vec3(transform * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(transform))) * aNormal;
-
-    if (material.texture.isTextured == 1) {
-        TexCoord = vec2(aTexCoord.x * material.texture.scale.x, aTexCoord.y * material.texture.scale.y);
-    } else {
-        TexCoord = vec2(aTexCoord.x, aTexCoord.y); 
-    }
+    vec3 position = positionOffset + aPos * positionScale;
+    vec3 normal = octNormals ? decodeOctahedral(aNormal.xy) : aNormal;
+
+    FragPos = vec3(transform * vec4(position, 1.0));
+    Normal = mat3(transpose(inverse(transform))) * normal;
+
+#ifdef TEXTURED
+    TexCoord = vec2(aTexCoord.x * material.texture.scale.x, aTexCoord.y * material.texture.scale.y);
+#else
+    TexCoord = vec2(aTexCoord.x, aTexCoord.y); 
+#endif
     
-    gl_Position = projection * view * vec4(FragPos, 1.0);
+    gl_Position = viewProjection * vec4(FragPos, 1.0);
 }
\ No newline at end of file
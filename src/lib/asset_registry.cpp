@@ -0,0 +1,260 @@
+#include "asset_registry.hpp"
+#include "mesh_cache.hpp"
+#include "logger.hpp"
+
+#include <algorithm>
+#include <exception>
+
+std::chrono::duration<double, std::milli> AssetRegistry::uploadBudget{ 4.0 };
+
+std::unordered_map<std::string, std::weak_ptr<const ModelAsset>> AssetRegistry::models;
+std::unordered_map<std::string, std::weak_ptr<const TextureAsset>> AssetRegistry::textures;
+
+std::mutex AssetRegistry::mutex;
+std::deque<AssetRegistry::PendingModel> AssetRegistry::parsedModels;
+std::deque<AssetRegistry::PendingTexture> AssetRegistry::decodedTextures;
+std::vector<AssetRegistry::PendingModel> AssetRegistry::uploadingModels;
+
+TextureAsset::~TextureAsset()
+{
+    if (id) glDeleteTextures(1, &id);
+}
+
+ModelAsset::~ModelAsset()
+{
+    for (Mesh& mesh : meshes) mesh.clear();
+}
+
+template <typename T>
+static size_t countAlive(const std::unordered_map<std::string, std::weak_ptr<const T>>& assets)
+{
+    size_t count = 0;
+    for (const auto& [key, asset] : assets) {
+        if (!asset.expired()) count++;
+    }
+    return count;
+}
+
+ThreadPool& AssetRegistry::pool()
+{
+    // Created on first use, so it is destroyed (and joined) before the queues it fills
+    static ThreadPool instance;
+    return instance;
+}
+
+std::string AssetRegistry::canonical(const std::filesystem::path& path)
+{
+    std::error_code error;
+    std::filesystem::path resolved = std::filesystem::weakly_canonical(path, error);
+    if (error) resolved = std::filesystem::absolute(path, error).lexically_normal();
+    return resolved.generic_string();
+}
+
+std::shared_ptr<const ModelAsset> AssetRegistry::model(const std::filesystem::path& filename, const ImportSettings& settings, const std::shared_ptr<LoadProgress>& progress)
+{
+    std::string key = canonical(filename) + "#" + std::to_string(settings.signature()) + "#" + std::to_string(static_cast<int>(settings.vertexFormat));
+
+    auto found = models.find(key);
+    if (found != models.end()) {
+        if (auto asset = found->second.lock()) return asset;
+    }
+
+    auto suffix = filename.extension().string();
+    if (suffix != ".obj") {
+        Logger::error("Unrecognized file extension: " + suffix);
+        return nullptr;
+    }
+
+    auto asset = std::make_shared<ModelAsset>();
+    asset->path = filename;
+    models[key] = asset;
+
+    if (progress) progress->requested++;
+
+    pool().submit([asset, filename, settings, progress]() mutable {
+        PendingModel pending;
+        pending.progress = progress;
+        pending.format = settings.vertexFormat;
+
+        // A failed file still goes through update(), which marks the asset and completes
+        // its progress, so nothing waiting on either hangs
+        try {
+            if (!MeshCache::load(filename, settings, pending.parts)) {
+                auto loader = OBJLoader(filename, settings);
+                pending.parts = std::move(loader.submeshes);
+                MeshCache::store(filename, settings, loader.libraries, pending.parts);
+            }
+
+            for (size_t i = 0; i < pending.parts.size(); ++i) {
+                const AABB& bounds = pending.parts[i].bounds;
+                pending.grid = i == 0 ? bounds : AABB{ glm::min(pending.grid.min, bounds.min), glm::max(pending.grid.max, bounds.max) };
+            }
+        }
+        catch (const std::exception& e) {
+            Logger::error("Unable to load " + filename.string() + ": " + e.what());
+            pending.parts.clear();
+            pending.failed = true;
+        }
+        catch (...) {
+            Logger::error("Unable to load " + filename.string());
+            pending.parts.clear();
+            pending.failed = true;
+        }
+
+        // A missing or empty file is reported by the loader and has no parts
+        if (pending.parts.empty()) pending.failed = true;
+
+        if (progress) progress->decoded++;
+
+        // Moved, the last reference to an asset must never be dropped off the main thread
+        pending.asset = std::move(asset);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        parsedModels.push_back(std::move(pending));
+    });
+
+    return asset;
+}
+
+std::shared_ptr<const TextureAsset> AssetRegistry::texture(const std::filesystem::path& filename, const std::shared_ptr<LoadProgress>& progress)
+{
+    std::string key = canonical(filename);
+
+    auto found = textures.find(key);
+    if (found != textures.end()) {
+        if (auto asset = found->second.lock()) return asset;
+    }
+
+    // Failed loads are shared as well, so a missing image is reported once
+    auto asset = std::make_shared<TextureAsset>();
+    asset->path = filename;
+    textures[key] = asset;
+
+    if (progress) progress->requested++;
+
+    pool().submit([asset, filename, progress]() mutable {
+        PendingTexture pending;
+        pending.progress = progress;
+
+        // Handed to update() either way, like a failed model
+        try {
+            pending.valid = TextureLoader::import(filename, pending.image);
+        }
+        catch (const std::exception& e) {
+            Logger::error("Unable to load " + filename.string() + ": " + e.what());
+            pending.valid = false;
+        }
+        catch (...) {
+            Logger::error("Unable to load " + filename.string());
+            pending.valid = false;
+        }
+
+        if (progress) progress->decoded++;
+
+        pending.asset = std::move(asset);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        decodedTextures.push_back(std::move(pending));
+    });
+
+    return asset;
+}
+
+void AssetRegistry::update()
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(uploadBudget);
+    bool progressed = false;
+
+    auto hasTime = [&] { return !progressed || std::chrono::steady_clock::now() < deadline; };
+
+    // Textures go first, meshes wait for the textures of their materials
+    while (hasTime()) {
+        PendingTexture pending;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (decodedTextures.empty()) break;
+            pending = std::move(decodedTextures.front());
+            decodedTextures.pop_front();
+        }
+
+        if (pending.valid) pending.asset->id = TextureLoader::upload(pending.image, pending.asset->path);
+        pending.asset->failed = pending.asset->id == 0;
+        pending.asset->loaded = true;
+
+        if (pending.progress) pending.progress->uploaded++;
+        progressed = true;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::move(parsedModels.begin(), parsedModels.end(), std::back_inserter(uploadingModels));
+        parsedModels.clear();
+    }
+
+    for (auto it = uploadingModels.begin(); it != uploadingModels.end() && hasTime();) {
+        if (uploadModel(*it, deadline, progressed)) it = uploadingModels.erase(it);
+        else ++it;
+    }
+}
+
+bool AssetRegistry::uploadModel(PendingModel& pending, std::chrono::steady_clock::time_point deadline, bool& progressed)
+{
+    ModelAsset& asset = *pending.asset;
+
+    if (pending.failed) {
+        asset.failed = true;
+        asset.loaded = true;
+        if (pending.progress) pending.progress->uploaded++;
+        progressed = true;
+        return true;
+    }
+
+    if (!pending.resolved) {
+        pending.images.resize(pending.parts.size());
+
+        for (size_t i = 0; i < pending.parts.size(); ++i) {
+            const Texture& texture = pending.parts[i].material.texture;
+            if (texture.path.empty()) continue;
+
+            pending.images[i] = AssetRegistry::texture(texture.path, pending.progress);
+
+            if (std::find(asset.textures.begin(), asset.textures.end(), pending.images[i]) == asset.textures.end()) {
+                asset.textures.push_back(pending.images[i]);
+            }
+        }
+
+        // Meshes already handed out for drawing must not move
+        asset.meshes.reserve(pending.parts.size());
+        pending.resolved = true;
+    }
+
+    while (pending.next < pending.parts.size()) {
+        MeshData& part = pending.parts[pending.next];
+        const auto& image = pending.images[pending.next];
+
+        if (image && !image->loaded) return false;
+        if (progressed && std::chrono::steady_clock::now() >= deadline) return false;
+
+        if (image && image->id != 0) part.material.texture.id = image->id;
+
+        asset.meshes.push_back(Mesh(part, pending.format, pending.grid));
+        pending.next++;
+        progressed = true;
+    }
+
+    asset.loaded = true;
+    if (pending.progress) pending.progress->uploaded++;
+
+    Logger::info("Loaded " + asset.path.string() + " (" + std::to_string(asset.meshes.size()) + " meshes)");
+    return true;
+}
+
+size_t AssetRegistry::modelCount()
+{
+    return countAlive(models);
+}
+
+size_t AssetRegistry::textureCount()
+{
+    return countAlive(textures);
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include <GL/glew.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mesh.hpp"
+#include "obj_loader.hpp"
+#include "texture_loader.hpp"
+#include "thread_pool.hpp"
+
+struct TextureAsset {
+    // 0 until uploaded, stays 0 if the image could not be loaded
+    GLuint id = 0;
+    std::filesystem::path path;
+    // Set once the texture is final, whether it was loaded or not
+    bool loaded = false;
+    // The image could not be read or uploaded, set together with loaded
+    bool failed = false;
+
+    TextureAsset() = default;
+    TextureAsset(const TextureAsset&) = delete;
+    TextureAsset& operator=(const TextureAsset&) = delete;
+    ~TextureAsset();
+};
+
+struct ModelAsset {
+    std::filesystem::path path;
+    // Filled in part by part as the meshes get uploaded
+    std::vector<Mesh> meshes;
+    // Keeps the textures referenced by the materials alive
+    std::vector<std::shared_ptr<const TextureAsset>> textures;
+    // Set once every mesh is uploaded (or the file failed to load)
+    bool loaded = false;
+    // The file could not be read, set together with loaded and there are no meshes
+    bool failed = false;
+
+    ModelAsset() = default;
+    ModelAsset(const ModelAsset&) = delete;
+    ModelAsset& operator=(const ModelAsset&) = delete;
+    ~ModelAsset();
+};
+
+/*
+    Progress of a group of asset requests, shared between the caller and the loaders.
+    Every requested file counts twice, once when it is read and once when it is on the GPU.
+*/
+struct LoadProgress {
+    std::atomic<unsigned int> requested{ 0 };
+    std::atomic<unsigned int> decoded{ 0 };
+    std::atomic<unsigned int> uploaded{ 0 };
+
+    float fraction() const {
+        unsigned int total = requested.load();
+        return total == 0 ? 1.0f : static_cast<float>(decoded.load() + uploaded.load()) / static_cast<float>(2 * total);
+    }
+
+    bool done() const { return uploaded.load() == requested.load(); }
+};
+
+/*
+    Loads every model and texture file once and hands out shared, immutable handles.
+    - assets are keyed by canonical path (and import settings and vertex format for models)
+    - the registry only holds weak references, an asset is freed with its last handle
+    - files are read and decoded on a thread pool, handles are returned right away
+      and their content appears when update() uploads it on the main thread
+    - everything except the pool jobs runs on the main thread
+*/
+class AssetRegistry
+{
+public:
+    // Main thread time update() may spend on uploads per call
+    static std::chrono::duration<double, std::milli> uploadBudget;
+
+    // Returns nullptr if the file type is not supported
+    static std::shared_ptr<const ModelAsset> model(const std::filesystem::path& filename, const ImportSettings& settings = ImportSettings{}, const std::shared_ptr<LoadProgress>& progress = nullptr);
+    static std::shared_ptr<const TextureAsset> texture(const std::filesystem::path& filename, const std::shared_ptr<LoadProgress>& progress = nullptr);
+
+    // Uploads finished work until the budget is spent, at least one step per call.
+    // Call once per frame before anything is submitted for drawing.
+    static void update();
+
+    // Number of assets still alive
+    static size_t modelCount();
+    static size_t textureCount();
+
+private:
+    struct PendingModel {
+        std::shared_ptr<ModelAsset> asset;
+        std::shared_ptr<LoadProgress> progress;
+        VertexFormat format = VertexFormat::Standard;
+        std::vector<MeshData> parts;
+        // Texture of every part, null if it has none
+        std::vector<std::shared_ptr<const TextureAsset>> images;
+        // Quantization grid shared by all parts, so their common edges match exactly
+        AABB grid{ glm::vec3(0.0f), glm::vec3(0.0f) };
+        size_t next = 0;
+        bool resolved = false;
+        bool failed = false;
+    };
+
+    struct PendingTexture {
+        std::shared_ptr<TextureAsset> asset;
+        std::shared_ptr<LoadProgress> progress;
+        Image image;
+        bool valid = false;
+    };
+
+    static std::unordered_map<std::string, std::weak_ptr<const ModelAsset>> models;
+    static std::unordered_map<std::string, std::weak_ptr<const TextureAsset>> textures;
+
+    // Filled by the pool, drained by update()
+    static std::mutex mutex;
+    static std::deque<PendingModel> parsedModels;
+    static std::deque<PendingTexture> decodedTextures;
+
+    // Main thread only
+    static std::vector<PendingModel> uploadingModels;
+
+    static ThreadPool& pool();
+    static std::string canonical(const std::filesystem::path& path);
+    // Returns true once every part of the model is uploaded
+    static bool uploadModel(PendingModel& pending, std::chrono::steady_clock::time_point deadline, bool& progressed);
+};
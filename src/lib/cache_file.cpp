@@ -0,0 +1,117 @@
+#include "cache_file.hpp"
+#include "mapped_file.hpp"
+#include "string_utils.hpp"
+#include "logger.hpp"
+
+#include <cstdio>
+
+// Describes the current state of a file, false if it cannot be read
+static bool describeFile(const std::filesystem::path& path, CacheDependency& output)
+{
+    MappedFile file(path);
+    if (!file.isOpen()) return false;
+
+    std::error_code error;
+    auto modified = std::filesystem::last_write_time(path, error);
+    if (error) return false;
+
+    output.size = file.size();
+    output.modified = modified.time_since_epoch().count();
+    output.hash = hashBytes(file.view());
+    return true;
+}
+
+std::filesystem::path CacheFile::path(const std::filesystem::path& directory, const std::filesystem::path& source, const std::string& extension)
+{
+    std::error_code error;
+    std::string key = std::filesystem::absolute(source, error).lexically_normal().generic_string();
+
+    char suffix[17];
+    snprintf(suffix, sizeof(suffix), "%016llx", static_cast<unsigned long long>(hashBytes(key)));
+
+    return directory / (source.filename().string() + "-" + suffix + extension);
+}
+
+bool CacheFile::describe(const std::vector<std::filesystem::path>& files, std::vector<CacheDependency>& output, const std::string& cacheName)
+{
+    output.assign(files.size(), CacheDependency{});
+
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (!describeFile(files[i], output[i])) {
+            Logger::warning(cacheName + " not written, " + files[i].string() + " cannot be read");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool CacheFile::validate(CacheReader& reader, uint32_t count, const std::string& cacheName)
+{
+    for (uint32_t i = 0; i < count; ++i) {
+        CacheDependency cached, current;
+        std::string path;
+        if (!reader.read(cached) || !reader.read(path, cached.pathLength)) return false;
+
+        std::error_code error;
+        auto size = std::filesystem::file_size(path, error);
+        if (error || size != cached.size) return false;
+
+        auto modified = std::filesystem::last_write_time(path, error);
+        if (error || modified.time_since_epoch().count() != cached.modified) return false;
+
+        if (!describeFile(path, current) || current.hash != cached.hash) {
+            Logger::debug(cacheName + " is outdated (" + path + ")");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void CacheFile::writeDependencies(CacheWriter& writer, const std::vector<std::filesystem::path>& files, std::vector<CacheDependency>& states)
+{
+    for (size_t i = 0; i < files.size(); ++i) {
+        std::string path = files[i].generic_string();
+        states[i].pathLength = static_cast<uint32_t>(path.size());
+        writer.write(states[i]);
+        writer.write(path.data(), path.size());
+    }
+}
+
+bool CacheFile::write(const std::filesystem::path& target, const std::function<void(CacheWriter&)>& body)
+{
+    std::error_code error;
+    std::filesystem::create_directories(target.parent_path(), error);
+
+    std::filesystem::path temporary = target;
+    temporary += ".tmp";
+
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            Logger::warning("Unable to write cache " + temporary.string());
+            return false;
+        }
+
+        CacheWriter writer(file);
+        body(writer);
+
+        if (!file.good()) {
+            Logger::warning("Unable to write cache " + temporary.string());
+            file.close();
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(temporary, target, error);
+    if (error) {
+        Logger::warning("Unable to write cache " + target.string() + ": " + error.message());
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+
+    Logger::debug("Written cache " + target.string());
+    return true;
+}
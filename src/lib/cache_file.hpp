@@ -0,0 +1,108 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+    Shared pieces of the binary caches (meshes, textures, ...).
+    - native byte order, every block starts 8 byte aligned
+    - a cache records the size, modification time and content hash of every
+      file it was built from and is valid only while all of them stay the same
+*/
+
+// State of a file a cache was built from, followed by its path in the cache
+struct CacheDependency {
+    uint64_t size;
+    int64_t modified;
+    uint64_t hash;
+    uint32_t pathLength;
+    uint32_t padding;
+};
+
+// Sequential bounds checked reader over a mapped cache file
+class CacheReader {
+public:
+    CacheReader(std::string_view data) : data(data) {}
+
+    static size_t aligned(size_t offset) { return (offset + 7) & ~size_t(7); }
+
+    bool read(void* output, size_t bytes) {
+        if (offset + bytes > data.size()) return false;
+        std::memcpy(output, data.data() + offset, bytes);
+        offset = aligned(offset + bytes);
+        return true;
+    }
+
+    template <typename T>
+    bool read(T& output) { return read(&output, sizeof(T)); }
+
+    bool read(std::string& output, size_t length) {
+        if (offset + length > data.size()) return false;
+        output.assign(data.data() + offset, length);
+        offset = aligned(offset + length);
+        return true;
+    }
+
+    template <typename T>
+    bool read(std::vector<T>& output, size_t count) {
+        if (offset + count * sizeof(T) > data.size()) return false;
+        output.resize(count);
+        return read(output.data(), count * sizeof(T));
+    }
+
+    // Moves to an absolute offset for files with an index of their blocks
+    bool seek(size_t position) {
+        if (position > data.size()) return false;
+        offset = position;
+        return true;
+    }
+
+private:
+    std::string_view data;
+    size_t offset = 0;
+};
+
+class CacheWriter {
+public:
+    CacheWriter(std::ofstream& file) : file(file) {}
+
+    void write(const void* input, size_t bytes) {
+        static const char zeros[8] = {};
+        file.write(static_cast<const char*>(input), bytes);
+        file.write(zeros, CacheReader::aligned(bytes) - bytes);
+        offset += CacheReader::aligned(bytes);
+    }
+
+    // Bytes written so far
+    size_t position() const { return offset; }
+
+    template <typename T>
+    void write(const T& input) { write(&input, sizeof(T)); }
+
+private:
+    std::ofstream& file;
+    size_t offset = 0;
+};
+
+class CacheFile
+{
+public:
+    // Cache file name of a source, unique per absolute path
+    static std::filesystem::path path(const std::filesystem::path& directory, const std::filesystem::path& source, const std::string& extension);
+
+    // Records the current state of the files, false (with a warning) if one cannot be read
+    static bool describe(const std::vector<std::filesystem::path>& files, std::vector<CacheDependency>& output, const std::string& cacheName);
+
+    // Reads 'count' dependency records and checks them, cheap checks (size, time) go first
+    static bool validate(CacheReader& reader, uint32_t count, const std::string& cacheName);
+
+    static void writeDependencies(CacheWriter& writer, const std::vector<std::filesystem::path>& files, std::vector<CacheDependency>& states);
+
+    // Writes aside and renames, so a crash never leaves a half written cache behind
+    static bool write(const std::filesystem::path& target, const std::function<void(CacheWriter&)>& body);
+};
@@ -0,0 +1,69 @@
+#include "frustum_culler.hpp"
+
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FRUSTUM_CULLER_SSE
+#include <xmmintrin.h>
+#endif
+
+bool FrustumCuller::intersects(const Frustum& frustum, const AABB& box)
+{
+    glm::vec3 center = (box.min + box.max) * 0.5f;
+    glm::vec3 extent = (box.max - box.min) * 0.5f;
+
+    // Distance of the center against the projected radius of the box
+    for (const glm::vec4& plane : frustum.planes) {
+        float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+        float radius = std::abs(plane.x) * extent.x + std::abs(plane.y) * extent.y + std::abs(plane.z) * extent.z;
+        if (distance + radius < 0.0f) return false;
+    }
+    return true;
+}
+
+void FrustumCuller::test(const Frustum& frustum, const AABB* boxes, size_t count, uint8_t* visible)
+{
+    size_t i = 0;
+
+#ifdef FRUSTUM_CULLER_SSE
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 zero = _mm_setzero_ps();
+
+    for (; i + 4 <= count; i += 4) {
+        const AABB* b = boxes + i;
+
+        // One box per lane, as centers and half extents
+        __m128 minX = _mm_setr_ps(b[0].min.x, b[1].min.x, b[2].min.x, b[3].min.x);
+        __m128 minY = _mm_setr_ps(b[0].min.y, b[1].min.y, b[2].min.y, b[3].min.y);
+        __m128 minZ = _mm_setr_ps(b[0].min.z, b[1].min.z, b[2].min.z, b[3].min.z);
+        __m128 maxX = _mm_setr_ps(b[0].max.x, b[1].max.x, b[2].max.x, b[3].max.x);
+        __m128 maxY = _mm_setr_ps(b[0].max.y, b[1].max.y, b[2].max.y, b[3].max.y);
+        __m128 maxZ = _mm_setr_ps(b[0].max.z, b[1].max.z, b[2].max.z, b[3].max.z);
+
+        __m128 centerX = _mm_mul_ps(_mm_add_ps(minX, maxX), half);
+        __m128 centerY = _mm_mul_ps(_mm_add_ps(minY, maxY), half);
+        __m128 centerZ = _mm_mul_ps(_mm_add_ps(minZ, maxZ), half);
+        __m128 extentX = _mm_mul_ps(_mm_sub_ps(maxX, minX), half);
+        __m128 extentY = _mm_mul_ps(_mm_sub_ps(maxY, minY), half);
+        __m128 extentZ = _mm_mul_ps(_mm_sub_ps(maxZ, minZ), half);
+
+        __m128 inside = _mm_cmpeq_ps(zero, zero);
+
+        for (const glm::vec4& plane : frustum.planes) {
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), centerX), _mm_mul_ps(_mm_set1_ps(plane.y), centerY)),
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), centerZ), _mm_set1_ps(plane.w)));
+            __m128 radius = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(std::abs(plane.x)), extentX), _mm_mul_ps(_mm_set1_ps(std::abs(plane.y)), extentY)),
+                _mm_mul_ps(_mm_set1_ps(std::abs(plane.z)), extentZ));
+
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), zero));
+        }
+
+        int mask = _mm_movemask_ps(inside);
+        for (int lane = 0; lane < 4; ++lane) visible[i + lane] = static_cast<uint8_t>((mask >> lane) & 1);
+    }
+#endif
+
+    for (; i < count; ++i) visible[i] = intersects(frustum, boxes[i]) ? 1 : 0;
+}
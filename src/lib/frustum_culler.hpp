@@ -0,0 +1,19 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "physics.hpp"
+
+/*
+    Frustum tests of world space boxes, four at a time with SSE where it is available.
+    - a box is outside when it lies entirely behind one of the planes, boxes near a corner
+      of the frustum may pass without being visible, nothing visible is ever rejected
+*/
+class FrustumCuller
+{
+public:
+    static bool intersects(const Frustum& frustum, const AABB& box);
+
+    // Writes 1 to visible[i] for every box that intersects the frustum, 0 otherwise
+    static void test(const Frustum& frustum, const AABB* boxes, size_t count, uint8_t* visible);
+};
@@ -1,5 +1,6 @@
 #include "gui.hpp"
 #include "video.hpp"
+#include "world.hpp"
 
 void GUI::render()
 {
@@ -22,6 +23,14 @@ void GUI::render()
     ImGui::Separator();
     
     ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+    ImGui::Text("Draws: %zu (%zu objects instanced)", Renderer::statistics.draws, Renderer::statistics.instanced);
+    ImGui::Text("Meshes: %zu visible, %zu culled, %zu occluded", Renderer::statistics.visible, Renderer::statistics.culled, Renderer::statistics.occluded);
+    ImGui::Text("State changes: %zu shader, %zu texture, %zu mesh", Renderer::statistics.shaderChanges, Renderer::statistics.textureChanges, Renderer::statistics.meshChanges);
+
+    if (World::progress && !World::progress->done()) {
+        ImGui::Text("Loading assets (%u/%u)", World::progress->uploaded.load(), World::progress->requested.load());
+        ImGui::ProgressBar(World::progress->fraction());
+    }
     
     ImGui::Separator();
     ImGui::Text("Press V to make camera static.");
@@ -43,6 +52,10 @@ void GUI::render()
     if (ImGui::Checkbox("Enable Fullscreen", &fullscreen)) {
         Renderer::setFullscreen(fullscreen);
     }
+
+    ImGui::Checkbox("Enable Occlusion Culling", &Renderer::occlusionCulling);
+    ImGui::Checkbox("Enable Order Independent Transparency", &Renderer::weightedBlended);
+    ImGui::Checkbox("Enable Depth Pre-pass", &Renderer::depthPrepass);
     
     ImGui::Separator();
     
@@ -0,0 +1,118 @@
+#include "light_clusters.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+void LightClusters::calculateBounds(const glm::mat4& projection)
+{
+    this->projection = projection;
+
+    // Planes of a standard OpenGL perspective matrix
+    nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+    farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+
+    const float logRatio = std::log(farPlane / nearPlane);
+    depthSlicing = glm::vec2(Z / logRatio, -Z * std::log(nearPlane) / logRatio);
+
+    bounds.resize(COUNT);
+    for (int z = 0; z < Z; ++z) {
+        float front = nearPlane * std::pow(farPlane / nearPlane, float(z) / Z);
+        float back = nearPlane * std::pow(farPlane / nearPlane, float(z + 1) / Z);
+
+        for (int y = 0; y < Y; ++y) {
+            for (int x = 0; x < X; ++x) {
+                // Tile edges in NDC, pushed out to both depths of the slice
+                float left = -1.0f + 2.0f * x / X, right = -1.0f + 2.0f * (x + 1) / X;
+                float bottom = -1.0f + 2.0f * y / Y, top = -1.0f + 2.0f * (y + 1) / Y;
+
+                AABB& box = bounds[(z * Y + y) * X + x];
+                box.min = glm::vec3(std::numeric_limits<float>::max());
+                box.max = glm::vec3(std::numeric_limits<float>::lowest());
+
+                for (float depth : { front, back }) {
+                    for (float ndcX : { left, right }) {
+                        for (float ndcY : { bottom, top }) {
+                            glm::vec3 corner(ndcX * depth / projection[0][0], ndcY * depth / projection[1][1], -depth);
+                            box.min = glm::min(box.min, corner);
+                            box.max = glm::max(box.max, corner);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+int LightClusters::sliceOf(float depth) const
+{
+    if (depth <= nearPlane) return 0;
+    return std::clamp(static_cast<int>(std::floor(std::log(depth) * depthSlicing.x + depthSlicing.y)), 0, Z - 1);
+}
+
+void LightClusters::build(const glm::mat4& view, const glm::mat4& projection, const std::vector<glm::vec4>& spheres)
+{
+    if (projection != this->projection) calculateBounds(projection);
+
+    overlaps.clear();
+
+    for (uint32_t light = 0; light < spheres.size(); ++light) {
+        const float radius = spheres[light].w;
+        const glm::vec3 center = glm::vec3(view * glm::vec4(glm::vec3(spheres[light]), 1.0f));
+
+        // Depth goes along -z in view space
+        float nearest = -center.z - radius, farthest = -center.z + radius;
+        if (farthest < nearPlane || nearest > farPlane) continue;
+
+        int z0 = sliceOf(nearest), z1 = sliceOf(farthest);
+        int x0 = 0, x1 = X - 1, y0 = 0, y1 = Y - 1;
+
+        // Tiles under the projected box of the sphere, all of them when it reaches behind the near plane
+        if (nearest > nearPlane) {
+            glm::vec2 low(std::numeric_limits<float>::max()), high(std::numeric_limits<float>::lowest());
+            for (int corner = 0; corner < 8; ++corner) {
+                glm::vec3 point = center + glm::vec3((corner & 1) ? radius : -radius, (corner & 2) ? radius : -radius, (corner & 4) ? radius : -radius);
+                glm::vec2 ndc(point.x * projection[0][0] / -point.z, point.y * projection[1][1] / -point.z);
+                low = glm::min(low, ndc);
+                high = glm::max(high, ndc);
+            }
+
+            if (high.x < -1.0f || high.y < -1.0f || low.x > 1.0f || low.y > 1.0f) continue;
+
+            x0 = std::clamp(static_cast<int>(std::floor((low.x * 0.5f + 0.5f) * X)), 0, X - 1);
+            x1 = std::clamp(static_cast<int>(std::floor((high.x * 0.5f + 0.5f) * X)), 0, X - 1);
+            y0 = std::clamp(static_cast<int>(std::floor((low.y * 0.5f + 0.5f) * Y)), 0, Y - 1);
+            y1 = std::clamp(static_cast<int>(std::floor((high.y * 0.5f + 0.5f) * Y)), 0, Y - 1);
+        }
+
+        // The exact sphere against box test inside the candidate range
+        for (int z = z0; z <= z1; ++z) {
+            for (int y = y0; y <= y1; ++y) {
+                for (int x = x0; x <= x1; ++x) {
+                    uint32_t cluster = (z * Y + y) * X + x;
+                    const AABB& box = bounds[cluster];
+                    glm::vec3 closest = glm::max(box.min, glm::min(center, box.max));
+                    glm::vec3 offset = closest - center;
+                    if (glm::dot(offset, offset) <= radius * radius) overlaps.emplace_back(cluster, light);
+                }
+            }
+        }
+    }
+
+    // Counting sort by cluster, lights keep their order inside every cluster
+    ranges.assign(COUNT, ClusterRange{ 0, 0 });
+    for (const auto& overlap : overlaps) ranges[overlap.first].count++;
+
+    uint32_t offset = 0;
+    for (ClusterRange& range : ranges) {
+        range.offset = offset;
+        offset += range.count;
+        range.count = 0;
+    }
+
+    indices.resize(overlaps.size());
+    for (const auto& [cluster, light] : overlaps) {
+        ClusterRange& range = ranges[cluster];
+        indices[range.offset + range.count++] = light;
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+#include "physics.hpp"
+
+// Lights of one cluster, a range of LightClusters::getIndices()
+struct ClusterRange {
+    uint32_t offset;
+    uint32_t count;
+};
+
+/*
+    Froxel grid over the view frustum for clustered forward shading (Olsson et al. 2012).
+    - X by Y screen tiles, Z slices spaced exponentially between the near and the far plane
+    - every cluster lists the lights whose sphere of influence touches its view space box
+    - CPU only, the renderer uploads the ranges and indices as they are
+*/
+class LightClusters
+{
+public:
+    // Handed to material.frag as CLUSTER_X, CLUSTER_Y and CLUSTER_Z, see LightSystem::defines
+    static const int X = 16;
+    static const int Y = 9;
+    static const int Z = 24;
+    static const int COUNT = X * Y * Z;
+
+    // Spheres are world space centers with their radius in w, indices refer to their order
+    void build(const glm::mat4& view, const glm::mat4& projection, const std::vector<glm::vec4>& spheres);
+
+    // Slice of a view depth d is floor(log(d) * x + y)
+    glm::vec2 getDepthSlicing() const { return depthSlicing; }
+
+    // Indexed by (z * Y + y) * X + x, x and y counted from the bottom left tile
+    const std::vector<ClusterRange>& getRanges() const { return ranges; }
+    const std::vector<uint32_t>& getIndices() const { return indices; }
+
+private:
+    // View space boxes of the clusters, they only change with the projection
+    glm::mat4 projection{ 0.0f };
+    std::vector<AABB> bounds;
+    float nearPlane = 0.0f;
+    float farPlane = 0.0f;
+    glm::vec2 depthSlicing{ 0.0f };
+
+    std::vector<ClusterRange> ranges;
+    std::vector<uint32_t> indices;
+    // Cluster and light of every overlap, before they are grouped by cluster
+    std::vector<std::pair<uint32_t, uint32_t>> overlaps;
+
+    void calculateBounds(const glm::mat4& projection);
+    int sliceOf(float depth) const;
+};
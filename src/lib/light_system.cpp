@@ -2,6 +2,22 @@
 #include "light_system.hpp"
 #include "shader.hpp"
 #include "light_point.hpp"
+#include "logger.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+// Fraction of a light's brightness below which it no longer counts, the shader fades it out towards there
+static const float LIGHT_CUTOFF = 1.0f / 256.0f;
+
+// Attenuation of point lights, they have no terms of their own
+static const float POINT_CONSTANT = 1.0f;
+static const float POINT_LINEAR = 0.09f;
+static const float POINT_QUADRATIC = 0.032f;
 
 void LightSystem::add(AmbientLight* light)
 {
@@ -25,66 +41,177 @@ void LightSystem::add(DirectionalLight* light)
 
 void LightSystem::add(Shader& shader)
 {
-    shaders.push_back(shader);
+    shader.getUniform<int>("lightClusters").set(static_cast<int>(LIGHT_CLUSTERS_UNIT));
+    shader.getUniform<int>("lightIndices").set(static_cast<int>(LIGHT_INDICES_UNIT));
 }
 
-void LightSystem::calc()
+void LightSystem::add(ShaderVariants& shaders)
 {
-    for (Shader shader : shaders) {
-        int index = 0;
-        //TODO: Convert this part to UBOs
-
-        for (auto light : pointLights) {
-            shader.activate();
-            shader.setUniform("pointLights[" + std::to_string(index) + "].position", light->position);
-            shader.setUniform("pointLights[" + std::to_string(index) + "].ambient", light->ambient);
-            shader.setUniform("pointLights[" + std::to_string(index) + "].diffuse", light->diffusion);
-            shader.setUniform("pointLights[" + std::to_string(index) + "].specular", light->specular);
-            shader.setUniform("pointLights[" + std::to_string(index) + "].constant", 1.0f);
-            shader.setUniform("pointLights[" + std::to_string(index) + "].linear", 0.09f);
-            shader.setUniform("pointLights[" + std::to_string(index) + "].quadratic", 0.032f);
-
-            index += 1;
+    shaders.setup([this](Shader& shader) { add(shader); });
+}
+
+ShaderDefines LightSystem::defines()
+{
+    return {
+        { "MAX_AMBIENT_LIGHTS", std::to_string(MAX_AMBIENT_LIGHTS) },
+        { "MAX_DIRECTIONAL_LIGHTS", std::to_string(MAX_DIRECTIONAL_LIGHTS) },
+        { "MAX_LIGHTS", std::to_string(lightCapacity()) },
+        { "CLUSTER_X", std::to_string(LightClusters::X) },
+        { "CLUSTER_Y", std::to_string(LightClusters::Y) },
+        { "CLUSTER_Z", std::to_string(LightClusters::Z) },
+    };
+}
+
+size_t LightSystem::lightCapacity()
+{
+    static const size_t capacity = [] {
+        // 16 KB is all the specification guarantees, 256 lights need more than that
+        GLint maxSize = 0;
+        glGetIntegerv(GL_MAX_UNIFORM_BLOCK_SIZE, &maxSize);
+
+        const size_t fixed = offsetof(LightsBlock, lights);
+        if (maxSize <= 0 || static_cast<size_t>(maxSize) < fixed + sizeof(LightRecord)) {
+            throw std::runtime_error("GL_MAX_UNIFORM_BLOCK_SIZE " + std::to_string(maxSize) + " is too small for the Lights block");
         }
 
-        index = 0;
-        //TODO: Convert this part to UBOs
-        for (const auto& light : spotLights) {
-            shader.activate();
-            shader.setUniform("spotLights[" + std::to_string(index) + "].position", light->position);
-            shader.setUniform("spotLights[" + std::to_string(index) + "].direction", light->direction);
-            shader.setUniform("spotLights[" + std::to_string(index) + "].ambient", light->ambient);
-            shader.setUniform("spotLights[" + std::to_string(index) + "].diffuse", light->diffusion);
-            shader.setUniform("spotLights[" + std::to_string(index) + "].specular", light->specular);
-            shader.setUniform("spotLights[" + std::to_string(index) + "].constant", light->constant);
-            shader.setUniform("spotLights[" + std::to_string(index) + "].linear", light->linear);
-            shader.setUniform("spotLights[" + std::to_string(index) + "].quadratic", light->quadratic);
-            shader.setUniform("spotLights[" + std::to_string(index) + "].cutOff", light->cutOff);
-            shader.setUniform("spotLights[" + std::to_string(index) + "].outerCutOff", light->outerCutOff);
-
-            index += 1;
+        size_t lights = std::min((static_cast<size_t>(maxSize) - fixed) / sizeof(LightRecord), MAX_LIGHTS);
+        if (lights < MAX_LIGHTS) {
+            Logger::info("Lights block limited to " + std::to_string(lights) + " point and spot lights by GL_MAX_UNIFORM_BLOCK_SIZE " + std::to_string(maxSize));
         }
+        return lights;
+    }();
+    return capacity;
+}
 
-        index = 0;
-        //TODO: Convert this part to UBOs
-        for (const auto& light : directionalLights) {
-            shader.activate();
-            shader.setUniform("directionalLights[" + std::to_string(index) + "].direction", light->direction);
-            shader.setUniform("directionalLights[" + std::to_string(index) + "].ambient", light->ambient);
-            shader.setUniform("directionalLights[" + std::to_string(index) + "].diffuse", light->diffusion);
-            shader.setUniform("directionalLights[" + std::to_string(index) + "].specular", light->specular);
+float LightSystem::influenceRadius(const glm::vec3& brightest, float constant, float linear, float quadratic)
+{
+    // Solves brightness / (constant + linear * d + quadratic * d^2) = LIGHT_CUTOFF for d
+    float limit = std::max({ brightest.x, brightest.y, brightest.z }) / LIGHT_CUTOFF;
+    if (limit <= constant) return 0.0f;
 
-            index += 1;
-        }
+    if (quadratic > 0.0f) return (-linear + std::sqrt(linear * linear + 4.0f * quadratic * (limit - constant))) / (2.0f * quadratic);
+    if (linear > 0.0f) return (limit - constant) / linear;
+    return std::numeric_limits<float>::max();
+}
+
+void LightSystem::TextureBuffer::upload(const void* data, size_t size, GLenum format)
+{
+    // Never empty, a texture without storage would not be complete
+    size_t required = std::max(size, size_t(16));
+
+    if (required > capacity) {
+        capacity = std::max(required, capacity * 2);
+        if (buffer) glDeleteBuffers(1, &buffer);
+        glCreateBuffers(1, &buffer);
+        glNamedBufferStorage(buffer, capacity, nullptr, GL_DYNAMIC_STORAGE_BIT);
 
-        index = 0;
-        //TODO: Convert this part to UBOs
-        for (const auto& light : ambientLights) {
-            shader.activate();
-            shader.setUniform("ambientLights[" + std::to_string(index) + "].color", light->color);
-            shader.setUniform("ambientLights[" + std::to_string(index) + "].intensity", light->intensity);
+        if (!texture) glCreateTextures(GL_TEXTURE_BUFFER, 1, &texture);
+        glTextureBuffer(texture, format, buffer);
+    }
+
+    if (size > 0) glNamedBufferSubData(buffer, 0, size, data);
+}
 
-            index += 1;
+template <typename T>
+void LightSystem::update(T& target, const T& value)
+{
+    if (std::memcmp(&target, &value, sizeof(T)) == 0) return;
+    target = value;
+
+    // Fields are updated in block order, so neighbours extend the last range
+    size_t offset = reinterpret_cast<const unsigned char*>(&target) - reinterpret_cast<const unsigned char*>(&block);
+    if (!dirty.empty() && dirty.back().first + dirty.back().second == offset) dirty.back().second += sizeof(T);
+    else dirty.emplace_back(offset, sizeof(T));
+}
+
+void LightSystem::uploadDirty()
+{
+    for (const auto& [offset, size] : dirty) {
+        glNamedBufferSubData(lightsBuffer, offset, size, reinterpret_cast<const unsigned char*>(&block) + offset);
+    }
+    dirty.clear();
+}
+
+void LightSystem::calc(const glm::mat4& view, const glm::mat4& projection)
+{
+    const size_t capacity = lightCapacity();
+
+    if (!lightsBuffer) {
+        // Only as long as the shaders declare the block, records past the capacity are never written.
+        // Starts out equal to the zeroed mirror, bound for good.
+        glCreateBuffers(1, &lightsBuffer);
+        glNamedBufferStorage(lightsBuffer, offsetof(LightsBlock, lights) + capacity * sizeof(LightRecord), &block, GL_DYNAMIC_STORAGE_BIT);
+        glBindBufferBase(GL_UNIFORM_BUFFER, static_cast<GLuint>(UniformBlock::Lights), lightsBuffer);
+    }
+
+    const size_t ambientCount = std::min(ambientLights.size(), MAX_AMBIENT_LIGHTS);
+    const size_t directionalCount = std::min(directionalLights.size(), MAX_DIRECTIONAL_LIGHTS);
+    const size_t lightCount = std::min(pointLights.size() + spotLights.size(), capacity);
+
+    if (lightCount < pointLights.size() + spotLights.size()) {
+        static bool warned = false;
+        if (!warned) Logger::warning("More than " + std::to_string(capacity) + " point and spot lights, the rest are left out");
+        warned = true;
+    }
+
+    update(block.counts, glm::ivec4(static_cast<int>(ambientCount), static_cast<int>(directionalCount), static_cast<int>(lightCount), 0));
+
+    for (size_t i = 0; i < ambientCount; ++i) {
+        update(block.ambientLights[i], AmbientRecord{ ambientLights[i]->color, ambientLights[i]->intensity });
+    }
+
+    for (size_t i = 0; i < directionalCount; ++i) {
+        const DirectionalLight* light = directionalLights[i];
+        update(block.directionalLights[i], DirectionalRecord{
+            glm::vec4(light->direction, 0.0f), glm::vec4(light->ambient, 0.0f), glm::vec4(light->diffusion, 0.0f), glm::vec4(light->specular, 0.0f) });
+    }
+
+    spheres.clear();
+
+    for (size_t i = 0; i < lightCount; ++i) {
+        LightRecord record{};
+
+        if (i < pointLights.size()) {
+            const PointLight* light = pointLights[i];
+            glm::vec3 brightest = glm::max(light->ambient, glm::max(light->diffusion, light->specular));
+            float radius = influenceRadius(brightest, POINT_CONSTANT, POINT_LINEAR, POINT_QUADRATIC);
+
+            record.positionRadius = glm::vec4(light->position, radius);
+            record.directionType = glm::vec4(0.0f);
+            record.ambient = glm::vec4(light->ambient, POINT_CONSTANT);
+            record.diffuse = glm::vec4(light->diffusion, POINT_LINEAR);
+            record.specular = glm::vec4(light->specular, POINT_QUADRATIC);
+            record.cone = glm::vec4(0.0f);
+        }
+        else {
+            const SpotLight* light = spotLights[i - pointLights.size()];
+            glm::vec3 brightest = glm::max(light->ambient, glm::max(light->diffusion, light->specular));
+            float radius = influenceRadius(brightest, light->constant, light->linear, light->quadratic);
+
+            record.positionRadius = glm::vec4(light->position, radius);
+            record.directionType = glm::vec4(light->direction, 1.0f);
+            record.ambient = glm::vec4(light->ambient, light->constant);
+            record.diffuse = glm::vec4(light->diffusion, light->linear);
+            record.specular = glm::vec4(light->specular, light->quadratic);
+            record.cone = glm::vec4(light->cutOff, light->outerCutOff, 0.0f, 0.0f);
         }
+
+        update(block.lights[i], record);
+        spheres.push_back(record.positionRadius);
     }
-}
\ No newline at end of file
+
+    // The clusters follow the camera, they are rebuilt every frame
+    clusters.build(view, projection, spheres);
+    glm::vec2 slicing = clusters.getDepthSlicing();
+    update(block.clusterDepth, glm::vec4(slicing.x, slicing.y, 0.0f, 0.0f));
+
+    uploadDirty();
+
+    const std::vector<ClusterRange>& ranges = clusters.getRanges();
+    const std::vector<uint32_t>& indices = clusters.getIndices();
+    clusterRanges.upload(ranges.data(), ranges.size() * sizeof(ClusterRange), GL_RG32UI);
+    lightIndices.upload(indices.data(), indices.size() * sizeof(uint32_t), GL_R32UI);
+
+    glBindTextureUnit(LIGHT_CLUSTERS_UNIT, clusterRanges.texture);
+    glBindTextureUnit(LIGHT_INDICES_UNIT, lightIndices.texture);
+}
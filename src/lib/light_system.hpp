@@ -1,32 +1,125 @@
 #pragma once
 
+#include <cstddef>
 #include <vector>
 #include <string>
-#include <unordered_map>
+#include <utility>
 #include <glm/glm.hpp>
 #include "shader.hpp"
+#include "shader_variants.hpp"
+#include "light_clusters.hpp"
 
 #include "light_ambient.hpp"
 #include "light_point.hpp"
 #include "light_spot.hpp"
 #include "light_directional.hpp"
 
+/*
+    Feeds the lights to every program through the Lights uniform block (std140, see LightsBlock).
+    - the block is mirrored on the CPU, calc only uploads the bytes that changed since the last frame
+    - point and spot lights are binned into LightClusters every frame, the cluster ranges and
+      light indices go to buffer textures
+*/
 class LightSystem {
 public:
+    // Array sizes of the Lights block, handed to material.frag through defines()
+    static const size_t MAX_AMBIENT_LIGHTS = 8;
+    static const size_t MAX_DIRECTIONAL_LIGHTS = 16;
+    // Point and spot lights together, fewer where GL_MAX_UNIFORM_BLOCK_SIZE is below the
+    // ~26 KB this takes, see lightCapacity
+    static const size_t MAX_LIGHTS = 256;
+
+    // Texture units of the cluster buffers, the material texture uses 0
+    static const GLuint LIGHT_CLUSTERS_UNIT = 4;
+    static const GLuint LIGHT_INDICES_UNIT = 5;
+
     LightSystem() = default;
 
     void add(AmbientLight* light);
     void add(PointLight* light);
     void add(SpotLight* light);
     void add(DirectionalLight* light);
+    // Points the cluster samplers of the program to their units, the block needs nothing
     void add(Shader& shader);
-    void calc();
+    void add(ShaderVariants& shaders);
+
+    // Array sizes and cluster counts the shaders reading the Lights block are compiled with
+    static ShaderDefines defines();
+
+    // Point and spot lights the Lights block holds on this driver, at most MAX_LIGHTS.
+    // Throws when the block does not fit even without them, needs a current context.
+    static size_t lightCapacity();
+
+    // The camera decides which clusters the lights end up in
+    void calc(const glm::mat4& view, const glm::mat4& projection);
+
+    // Distance at which the brightest channel of the colors has faded below LIGHT_CUTOFF
+    static float influenceRadius(const glm::vec3& brightest, float constant, float linear, float quadratic);
 
 private:
-    std::vector<Shader> shaders;
+    struct AmbientRecord {
+        glm::vec3 color;
+        float intensity;
+    };
+
+    struct DirectionalRecord {
+        glm::vec4 direction;
+        glm::vec4 ambient;
+        glm::vec4 diffuse;
+        glm::vec4 specular;
+    };
+
+    // Ambient, diffuse and specular carry constant, linear and quadratic in w, type 0 is a point light
+    struct LightRecord {
+        glm::vec4 positionRadius;
+        glm::vec4 directionType;
+        glm::vec4 ambient;
+        glm::vec4 diffuse;
+        glm::vec4 specular;
+        glm::vec4 cone; // cutOff, outerCutOff
+    };
+
+    // The Lights uniform block as std140 lays it out
+    struct LightsBlock {
+        glm::ivec4 counts; // ambient, directional, point and spot
+        glm::vec4 clusterDepth;
+        AmbientRecord ambientLights[MAX_AMBIENT_LIGHTS];
+        DirectionalRecord directionalLights[MAX_DIRECTIONAL_LIGHTS];
+        LightRecord lights[MAX_LIGHTS];
+    };
+
+    static_assert(offsetof(LightsBlock, ambientLights) == 32, "LightsBlock must match the std140 layout of the Lights block");
+    static_assert(offsetof(LightsBlock, lights) == 32 + 16 * MAX_AMBIENT_LIGHTS + 64 * MAX_DIRECTIONAL_LIGHTS, "LightsBlock must match the std140 layout of the Lights block");
+    static_assert(sizeof(LightRecord) == 96, "LightRecord must match ClusterLight in material.frag");
+
+    // What the buffer holds, compared against to find the changed ranges
+    LightsBlock block{};
+    GLuint lightsBuffer = 0;
+    // Byte ranges of block changed this frame, adjacent ones merged
+    std::vector<std::pair<size_t, size_t>> dirty;
+
+    // Copies value into the block when it differs, marking its bytes dirty
+    template <typename T>
+    void update(T& target, const T& value);
+    void uploadDirty();
+
+    // Buffer with a texture view of it, grown when the data outgrows it
+    struct TextureBuffer {
+        GLuint buffer = 0;
+        GLuint texture = 0;
+        size_t capacity = 0;
+
+        void upload(const void* data, size_t size, GLenum format);
+    };
+
+    LightClusters clusters;
+    std::vector<glm::vec4> spheres;
+
+    TextureBuffer clusterRanges;
+    TextureBuffer lightIndices;
 
     std::vector<AmbientLight*> ambientLights;
     std::vector<PointLight*> pointLights;
     std::vector<SpotLight*> spotLights;
     std::vector<DirectionalLight*> directionalLights;
-};
\ No newline at end of file
+};
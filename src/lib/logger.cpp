@@ -1,5 +1,7 @@
 #include "logger.hpp"
 
+#include <mutex>
+
 void Logger::debug(const std::string &message)
 {
     Logger::log(DEBUG, message);
@@ -27,7 +29,11 @@ void Logger::critical(const std::string &message)
 
 void Logger::log(Severity severity, const std::string &message)
 {
+    // Assets are loaded on worker threads, keep their lines whole
+    static std::mutex mutex;
+
     {
+        std::lock_guard<std::mutex> lock(mutex);
         std::time_t now = std::time(nullptr);
         std::tm tm_now;
 
@@ -0,0 +1,92 @@
+#include "mapped_file.hpp"
+
+#if defined(_WIN32) || defined(_WIN64)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32) || defined(_WIN64)
+
+MappedFile::MappedFile(const std::filesystem::path& filename)
+{
+    HANDLE file = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        return;
+    }
+
+    fileHandle = file;
+    length = static_cast<size_t>(fileSize.QuadPart);
+    opened = true;
+
+    // Zero sized files cannot be mapped, but they are still valid files.
+    if (length == 0) return;
+
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        opened = false;
+        return;
+    }
+
+    mappingHandle = mapping;
+    address = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (address == nullptr) opened = false;
+}
+
+MappedFile::~MappedFile()
+{
+    if (address) UnmapViewOfFile(address);
+    if (mappingHandle) CloseHandle(mappingHandle);
+    if (fileHandle) CloseHandle(fileHandle);
+}
+
+#else
+
+MappedFile::MappedFile(const std::filesystem::path& filename)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1) return;
+
+    struct stat info;
+    if (fstat(fd, &info) == -1) {
+        close(fd);
+        return;
+    }
+
+    length = static_cast<size_t>(info.st_size);
+    opened = true;
+
+    // Zero sized files cannot be mapped, but they are still valid files.
+    if (length > 0) {
+        void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (mapping == MAP_FAILED) {
+            opened = false;
+            length = 0;
+        }
+        else {
+            // We are going to walk the file front to back exactly once.
+            madvise(mapping, length, MADV_SEQUENTIAL);
+            address = static_cast<const char*>(mapping);
+        }
+    }
+
+    // The mapping keeps its own reference to the file.
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (address) munmap(const_cast<char*>(address), length);
+}
+
+#endif
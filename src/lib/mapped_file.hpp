@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <filesystem>
+#include <string_view>
+
+/*
+    Read-only memory mapping of a whole file.
+    - the mapping lives as long as the object, views into it must not outlive it
+    - an empty file is a valid (open) mapping with an empty view
+*/
+class MappedFile
+{
+public:
+    MappedFile(const std::filesystem::path& filename);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool isOpen() const { return opened; }
+    size_t size() const { return length; }
+    const char* data() const { return address; }
+    std::string_view view() const { return std::string_view(address, length); }
+
+private:
+    const char* address = nullptr;
+    size_t length = 0;
+    bool opened = false;
+
+#if defined(_WIN32) || defined(_WIN64)
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
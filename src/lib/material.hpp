@@ -1,10 +1,13 @@
 #pragma once
 #include <sstream>
+#include <string>
 #include <glm/glm.hpp>
 
 struct Texture {
     int id = -1;
     glm::vec3 scale = glm::vec3(100.0f);
+    // Image the texture was loaded from, empty if there is none
+    std::string path;
 };
 
 struct Material {
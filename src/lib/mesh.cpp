@@ -2,44 +2,132 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
 
 Mesh::Mesh(GLenum primitive_type, std::vector<Vertex>& vertices, std::vector<GLuint>& indices, GLuint texture_id) : 
     primitive_type(primitive_type),
     vertices(vertices),
     indices(indices),
     texture_id(texture_id)
+{
+    bounds = MeshData::calculateBounds(vertices);
+    sphere = MeshData::calculateSphere(vertices, bounds);
+    lods = { MeshLod{ 0, static_cast<uint32_t>(indices.size()), 0.0f } };
+    upload(bounds);
+}
+
+Mesh::Mesh(const MeshData& data) : Mesh(data, VertexFormat::Standard, data.bounds)
+{
+}
+
+Mesh::Mesh(const MeshData& data, VertexFormat format, const AABB& grid) :
+    vertices(data.vertices),
+    indices(data.indices),
+    material(data.material),
+    bounds(data.bounds),
+    meshlets(data.meshlets),
+    lods(data.lods),
+    format(format)
+{
+    sphere = MeshData::calculateSphere(vertices, bounds);
+    if (lods.empty()) lods.push_back(MeshLod{ 0, static_cast<uint32_t>(indices.size()), 0.0f });
+    upload(grid);
+}
+
+void Mesh::upload(const AABB& grid)
 {
     glCreateVertexArrays(1, &VAO);
     glCreateBuffers(1, &VBO);
     glCreateBuffers(1, &EBO);
 
-    glNamedBufferStorage(VBO, vertices.size() * sizeof(Vertex), vertices.data(), 0); // 0 for static, or use GL_DYNAMIC_STORAGE_BIT
-    glNamedBufferStorage(EBO, indices.size() * sizeof(GLuint), indices.data(), 0);
+    EncodedVertices encoded = VertexEncoder::encode(vertices, format, grid);
+    positionOffset = encoded.positionOffset;
+    positionScale = encoded.positionScale;
+    octNormals = encoded.octNormals;
+
+    glNamedBufferStorage(VBO, encoded.data.size(), encoded.data.data(), 0); // 0 for static, or use GL_DYNAMIC_STORAGE_BIT
+
+    // Half the index bandwidth whenever every index fits into 16 bits.
+    // The CPU copy stays 32-bit, so nothing else has to care.
+    if (vertices.size() <= std::numeric_limits<GLushort>::max() + size_t(1)) {
+        std::vector<GLushort> shortIndices(indices.begin(), indices.end());
+        glNamedBufferStorage(EBO, shortIndices.size() * sizeof(GLushort), shortIndices.data(), 0);
+        index_type = GL_UNSIGNED_SHORT;
+    }
+    else {
+        glNamedBufferStorage(EBO, indices.size() * sizeof(GLuint), indices.data(), 0);
+        index_type = GL_UNSIGNED_INT;
+    }
 
     glVertexArrayElementBuffer(VAO, EBO);
-    glVertexArrayVertexBuffer(VAO, 0, VBO, 0, sizeof(Vertex));
+    glVertexArrayVertexBuffer(VAO, 0, VBO, 0, encoded.layout.stride);
+    encoded.layout.apply(VAO, 0); // All vertex attributes come from binding point 0
+    InstanceLayout::apply(VAO);   // the buffer behind it is bound by the renderer before every draw
+
+    // Depth only passes fetch a fraction of the vertex data
+    EncodedVertices positions = encoded.positionsOnly();
+    glCreateVertexArrays(1, &depthVAO);
+    glCreateBuffers(1, &positionVBO);
+    glNamedBufferStorage(positionVBO, positions.data.size(), positions.data.data(), 0);
+
+    glVertexArrayElementBuffer(depthVAO, EBO);
+    glVertexArrayVertexBuffer(depthVAO, 0, positionVBO, 0, positions.layout.stride);
+    positions.layout.apply(depthVAO, 0);
+    InstanceLayout::apply(depthVAO);
+}
+
+void Mesh::draw(size_t lod) const
+{
+    const MeshLod& level = lods[std::min(lod, lods.size() - 1)];
+    const size_t indexSize = index_type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
 
-    glEnableVertexArrayAttrib(VAO, 0);
-    glVertexArrayAttribFormat(VAO, 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Position));
-    glVertexArrayAttribBinding(VAO, 0, 0); // Map attribute 0 to binding point 0
+    glDrawElements(primitive_type, static_cast<GLsizei>(level.indexCount), index_type, reinterpret_cast<const void*>(static_cast<uintptr_t>(level.indexOffset) * indexSize));
+}
 
-    glEnableVertexArrayAttrib(VAO, 1);
-    glVertexArrayAttribFormat(VAO, 1, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Normal));
-    glVertexArrayAttribBinding(VAO, 1, 0); // Map attribute 1 to binding point 0
+void Mesh::drawInstanced(size_t lod, GLsizei instanceCount) const
+{
+    const MeshLod& level = lods[std::min(lod, lods.size() - 1)];
+    const size_t indexSize = index_type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
 
-    glEnableVertexArrayAttrib(VAO, 2);
-    glVertexArrayAttribFormat(VAO, 2, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, UVs));
-    glVertexArrayAttribBinding(VAO, 2, 0); // Map attribute 2 to binding point 0
+    glDrawElementsInstanced(primitive_type, static_cast<GLsizei>(level.indexCount), index_type, reinterpret_cast<const void*>(static_cast<uintptr_t>(level.indexOffset) * indexSize), instanceCount);
 }
 
-void Mesh::draw(Shader& shader)
+void Mesh::draw(const Frustum& frustum, const glm::vec3& camera, bool cullBackfaces) const
 {
-	shader.activate();
+    if (meshlets.size() <= 1) {
+        draw(0);
+        return;
+    }
+
+    // Only ever filled on the render thread, kept to avoid allocating every draw
+    static std::vector<GLsizei> counts;
+    static std::vector<const void*> offsets;
+    counts.clear();
+    offsets.clear();
+
+    const size_t indexSize = index_type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+    uint32_t lastEnd = std::numeric_limits<uint32_t>::max();
 
-	glBindVertexArray(VAO);
-    glDrawElements(primitive_type, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, nullptr);
-    glBindVertexArray(0);
+    for (const Meshlet& meshlet : meshlets) {
+        if (!frustum.intersects(meshlet.center, meshlet.radius)) continue;
+        if (cullBackfaces && meshlet.isBackfacing(camera)) continue;
 
+        // Clusters are stored back to back, visible neighbours become one range
+        if (meshlet.indexOffset == lastEnd) {
+            counts.back() += static_cast<GLsizei>(meshlet.indexCount);
+        }
+        else {
+            counts.push_back(static_cast<GLsizei>(meshlet.indexCount));
+            offsets.push_back(reinterpret_cast<const void*>(static_cast<uintptr_t>(meshlet.indexOffset) * indexSize));
+        }
+        lastEnd = meshlet.indexOffset + meshlet.indexCount;
+    }
+
+    if (counts.empty()) return;
+
+    glMultiDrawElements(primitive_type, counts.data(), index_type, offsets.data(), static_cast<GLsizei>(counts.size()));
 }
 
 void Mesh::clear()
@@ -47,8 +135,39 @@ void Mesh::clear()
     if (VAO) glDeleteVertexArrays(1, &VAO);
     if (VBO) glDeleteBuffers(1, &VBO);
     if (EBO) glDeleteBuffers(1, &EBO);
+    if (depthVAO) glDeleteVertexArrays(1, &depthVAO);
+    if (positionVBO) glDeleteBuffers(1, &positionVBO);
 
     vertices.clear();
     indices.clear();
+    meshlets.clear();
+    lods.clear();
     VAO = VBO = EBO = 0;
+    depthVAO = positionVBO = 0;
+}
+
+AABB MeshData::calculateBounds(const std::vector<Vertex>& vertices)
+{
+    if (vertices.empty()) {
+        return AABB{ glm::vec3(0.0f), glm::vec3(0.0f) };
+    }
+
+    AABB bounds{ vertices.front().Position, vertices.front().Position };
+    for (const auto& vertex : vertices) {
+        bounds.min = glm::min(bounds.min, vertex.Position);
+        bounds.max = glm::max(bounds.max, vertex.Position);
+    }
+
+    return bounds;
+}
+
+Sphere MeshData::calculateSphere(const std::vector<Vertex>& vertices, const AABB& bounds)
+{
+    Sphere sphere{ (bounds.min + bounds.max) * 0.5f, 0.0f };
+
+    for (const auto& vertex : vertices) {
+        sphere.radius = std::max(sphere.radius, glm::length(vertex.Position - sphere.center));
+    }
+
+    return sphere;
 }
@@ -1,12 +1,67 @@
 #pragma once
 #include <glm/glm.hpp> 
 #include <glm/ext.hpp>
+#include <cstdint>
 #include <string>
 #include <vector>
 
 #include "shader.hpp"
 #include "vertex.hpp"
 #include "material.hpp"
+#include "physics.hpp"
+#include "vertex_layout.hpp"
+
+/*
+    Cluster of neighbouring triangles, a contiguous range of the index buffer.
+    - bounding sphere for frustum culling
+    - normal cone for backface culling, every triangle faces away from a camera at
+      dot(center - camera, coneAxis) >= coneCutoff * |center - camera| + radius
+*/
+struct Meshlet {
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    glm::vec3 center;
+    float radius;
+    glm::vec3 coneAxis;
+    float coneCutoff; // sine of the cone angle, 1 when the cluster can not be backface culled
+
+    bool isBackfacing(const glm::vec3& camera) const {
+        glm::vec3 direction = center - camera;
+        return glm::dot(direction, coneAxis) >= coneCutoff * glm::length(direction) + radius;
+    }
+};
+
+// Level of detail, a range of the index buffer drawn with the shared vertices
+struct MeshLod {
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    float error; // distance to the full mesh in model units, see MeshSimplifier
+};
+
+// Vertex data a draw reads, the position stream feeds depth only passes
+enum class VertexStream {
+    Full,
+    Position
+};
+
+/*
+    CPU side mesh as produced by the importers (or read from the mesh cache).
+    - holds everything Mesh needs to upload itself, no OpenGL objects
+*/
+struct MeshData {
+    std::vector<Vertex> vertices;
+    std::vector<GLuint> indices;
+    Material material;
+    AABB bounds{ glm::vec3(0.0f), glm::vec3(0.0f) };
+    // Empty unless the importer built clusters, see MeshletBuilder. They cover the first level only.
+    std::vector<Meshlet> meshlets;
+    // Empty unless the importer built levels, the first one is the full mesh
+    std::vector<MeshLod> lods;
+
+    static AABB calculateBounds(const std::vector<Vertex>& vertices);
+    // Centered on the box, enclosing every vertex
+    static Sphere calculateSphere(const std::vector<Vertex>& vertices, const AABB& bounds);
+};
 
 /*
     - if texture_id is 0 it means that there is no texture.
@@ -20,6 +75,20 @@ public:
     GLenum primitive_type = GL_TRIANGLES;
     Material material;
 
+    // Local space bounds of the vertices, computed once when the mesh is created
+    AABB bounds{ glm::vec3(0.0f), glm::vec3(0.0f) };
+    Sphere sphere{ glm::vec3(0.0f), 0.0f };
+    // Clusters of the index buffer, culled one by one when there are several
+    std::vector<Meshlet> meshlets;
+    // Coarser index ranges, never empty, the first one is the full mesh
+    std::vector<MeshLod> lods;
+
+    // GPU vertex format, the shader restores positions as positionOffset + position * positionScale
+    VertexFormat format = VertexFormat::Standard;
+    glm::vec3 positionOffset{ 0.0f };
+    glm::vec3 positionScale{ 1.0f };
+    bool octNormals = false;
+
     // Mesh material
     glm::vec3 ambient{ 0.1f };
     glm::vec3 diffuse{ 0.0f };
@@ -28,12 +97,30 @@ public:
 
     // Indirect (indexed) Draw 
     Mesh(GLenum primitive_type, std::vector<Vertex>& vertices, std::vector<GLuint>& indices, GLuint texture_id);
+    Mesh(const MeshData& data);
+    // Quantized positions are stored relative to the grid, see VertexEncoder
+    Mesh(const MeshData& data, VertexFormat format, const AABB& grid);
 
-    void draw(Shader& shader);
+    // The draws leave state to the caller, the program and vertexArray() of the stream must be bound
+    void draw(size_t lod = 0) const;
+    // Draws only the clusters intersecting the frustum and, with cullBackfaces, facing the camera.
+    // Both are in the local space of the mesh. Meshes without clusters are drawn whole, always at full detail.
+    void draw(const Frustum& frustum, const glm::vec3& camera, bool cullBackfaces) const;
+    // One draw of the level for every instance, the matrices come from InstanceLayout::BINDING
+    void drawInstanced(size_t lod, GLsizei instanceCount) const;
     void clear();
 
+    GLuint vertexArray(VertexStream stream = VertexStream::Full) const { return stream == VertexStream::Position ? depthVAO : VAO; }
+
 private:
     // OpenGL buffer IDs
     // ID = 0 is reserved (i.e. uninitalized)
     unsigned int VAO, VBO, EBO;
+    // Positions only, sharing the EBO
+    unsigned int depthVAO, positionVBO;
+
+    void upload(const AABB& grid);
+
+    // Meshes with at most 65536 vertices are drawn with 16-bit indices
+    GLenum index_type = GL_UNSIGNED_INT;
 };
@@ -0,0 +1,150 @@
+#include "mesh_cache.hpp"
+#include "mapped_file.hpp"
+#include "cache_file.hpp"
+#include "logger.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+/*
+    File layout, see cache_file.hpp for the conventions:
+    - FileHeader
+    - dependencyCount * (CacheDependency, path)
+    - meshCount * (MeshHeader, name, texture path, vertices, indices, meshlets, lods)
+*/
+
+// Bump whenever the layout or the importer output changes
+static const uint32_t MESH_CACHE_VERSION = 4;
+static const char MESH_CACHE_MAGIC[4] = { 'I', 'C', 'P', 'M' };
+
+struct FileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t vertexSize;
+    uint32_t dependencyCount;
+    uint32_t meshCount;
+    uint32_t settings;
+};
+
+struct MeshHeader {
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t meshletCount;
+    uint32_t lodCount;
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    glm::vec3 ambient;
+    glm::vec3 diffuse;
+    glm::vec3 specular;
+    glm::vec3 textureScale;
+    float transparency;
+    float shininess;
+    uint32_t nameLength;
+    uint32_t texturePathLength;
+};
+
+std::filesystem::path MeshCache::directory = "cache/meshes";
+
+std::filesystem::path MeshCache::cachePath(const std::filesystem::path& source)
+{
+    return CacheFile::path(directory, source, ".meshcache");
+}
+
+bool MeshCache::load(const std::filesystem::path& source, const ImportSettings& settings, std::vector<MeshData>& output)
+{
+    output.clear();
+
+    MappedFile file(cachePath(source));
+    if (!file.isOpen()) return false;
+
+    CacheReader reader(file.view());
+
+    FileHeader header;
+    if (!reader.read(header)) return false;
+    if (std::memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic)) != 0) return false;
+    if (header.version != MESH_CACHE_VERSION || header.vertexSize != sizeof(Vertex)) return false;
+    if (header.settings != settings.signature()) return false;
+
+    if (!CacheFile::validate(reader, header.dependencyCount, "Mesh cache of " + source.string())) return false;
+
+    output.resize(header.meshCount);
+    for (MeshData& mesh : output) {
+        MeshHeader record;
+        Material& material = mesh.material;
+
+        bool valid = reader.read(record) &&
+            reader.read(material.name, record.nameLength) &&
+            reader.read(material.texture.path, record.texturePathLength) &&
+            reader.read(mesh.vertices, record.vertexCount) &&
+            reader.read(mesh.indices, record.indexCount) &&
+            reader.read(mesh.meshlets, record.meshletCount) &&
+            reader.read(mesh.lods, record.lodCount);
+
+        if (!valid) {
+            Logger::warning("Mesh cache of " + source.string() + " is truncated");
+            output.clear();
+            return false;
+        }
+
+        mesh.bounds = AABB{ record.boundsMin, record.boundsMax };
+        material.ambient = record.ambient;
+        material.diffuse = record.diffuse;
+        material.specular = record.specular;
+        material.transparency = record.transparency;
+        material.shininess = record.shininess;
+        material.texture.scale = record.textureScale;
+    }
+
+    Logger::info("Loaded " + source.string() + " from the mesh cache");
+    return true;
+}
+
+void MeshCache::store(const std::filesystem::path& source, const ImportSettings& settings, const std::vector<std::filesystem::path>& dependencies, const std::vector<MeshData>& meshes)
+{
+    std::vector<std::filesystem::path> files{ source };
+    files.insert(files.end(), dependencies.begin(), dependencies.end());
+
+    std::vector<CacheDependency> states;
+    if (!CacheFile::describe(files, states, "Mesh cache of " + source.string())) return;
+
+    CacheFile::write(cachePath(source), [&](CacheWriter& writer) {
+        FileHeader header{};
+        std::memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+        header.version = MESH_CACHE_VERSION;
+        header.vertexSize = sizeof(Vertex);
+        header.dependencyCount = static_cast<uint32_t>(files.size());
+        header.meshCount = static_cast<uint32_t>(meshes.size());
+        header.settings = settings.signature();
+        writer.write(header);
+
+        CacheFile::writeDependencies(writer, files, states);
+
+        for (const MeshData& mesh : meshes) {
+            const Material& material = mesh.material;
+
+            MeshHeader record{};
+            record.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+            record.indexCount = static_cast<uint32_t>(mesh.indices.size());
+            record.meshletCount = static_cast<uint32_t>(mesh.meshlets.size());
+            record.lodCount = static_cast<uint32_t>(mesh.lods.size());
+            record.boundsMin = mesh.bounds.min;
+            record.boundsMax = mesh.bounds.max;
+            record.ambient = material.ambient;
+            record.diffuse = material.diffuse;
+            record.specular = material.specular;
+            record.textureScale = material.texture.scale;
+            record.transparency = material.transparency;
+            record.shininess = material.shininess;
+            record.nameLength = static_cast<uint32_t>(material.name.size());
+            record.texturePathLength = static_cast<uint32_t>(material.texture.path.size());
+
+            writer.write(record);
+            writer.write(material.name.data(), material.name.size());
+            writer.write(material.texture.path.data(), material.texture.path.size());
+            writer.write(mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+            writer.write(mesh.indices.data(), mesh.indices.size() * sizeof(GLuint));
+            writer.write(mesh.meshlets.data(), mesh.meshlets.size() * sizeof(Meshlet));
+            writer.write(mesh.lods.data(), mesh.lods.size() * sizeof(MeshLod));
+        }
+    });
+}
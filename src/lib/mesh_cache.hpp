@@ -0,0 +1,29 @@
+#pragma once
+#include <filesystem>
+#include <vector>
+
+#include "mesh.hpp"
+#include "obj_loader.hpp"
+
+/*
+    Binary cache of imported meshes, GPU ready vertex/index blobs with materials and bounds.
+    - one file per source model in the cache directory
+    - a cache is valid only while the size, modification time and content hash
+      of the source and of every file it depends on (MTL libraries) stay the same
+      and it was imported with the same settings
+*/
+class MeshCache
+{
+public:
+    static std::filesystem::path directory;
+
+    // Fills the output from the cache of the source.
+    // Returns false if there is no valid cache, the output is left empty then.
+    static bool load(const std::filesystem::path& source, const ImportSettings& settings, std::vector<MeshData>& output);
+
+    // Writes the meshes imported from the source into its cache.
+    static void store(const std::filesystem::path& source, const ImportSettings& settings, const std::vector<std::filesystem::path>& dependencies, const std::vector<MeshData>& meshes);
+
+private:
+    static std::filesystem::path cachePath(const std::filesystem::path& source);
+};
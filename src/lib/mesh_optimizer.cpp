@@ -0,0 +1,300 @@
+#include "mesh_optimizer.hpp"
+#include "logger.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <limits>
+#include <numeric>
+#include <sstream>
+
+/*
+    FIFO post-transform cache simulated with timestamps.
+    A vertex is cached if fewer than 'size' vertices were inserted after it.
+*/
+class CacheSimulation {
+public:
+    CacheSimulation(size_t vertexCount, unsigned int size) : stamps(vertexCount, 0), size(size), time(size + 1) {}
+
+    // Returns true on a cache miss
+    bool access(GLuint vertex) {
+        if (time - stamps[vertex] <= size) return false;
+        stamps[vertex] = time++;
+        return true;
+    }
+
+    // Forgets everything cached so far
+    void reset() { time += size + 1; }
+
+private:
+    std::vector<unsigned int> stamps;
+    unsigned int size;
+    unsigned int time;
+};
+
+static std::string format(float value)
+{
+    std::ostringstream output;
+    output << std::fixed << std::setprecision(3) << value;
+    return output.str();
+}
+
+void MeshOptimizer::optimize(MeshData& mesh)
+{
+    if (mesh.indices.empty()) return;
+
+    Statistics before = analyze(mesh.indices, mesh.vertices.size());
+
+    optimizeVertexCache(mesh.indices, mesh.vertices.size());
+    optimizeOverdraw(mesh.indices, mesh.vertices);
+    optimizeVertexFetch(mesh.vertices, mesh.indices);
+
+    Statistics after = analyze(mesh.indices, mesh.vertices.size());
+
+    Logger::debug("Optimized mesh " + mesh.material.name +
+        ": ACMR " + format(before.acmr) + " -> " + format(after.acmr) +
+        ", ATVR " + format(before.atvr) + " -> " + format(after.atvr));
+}
+
+MeshOptimizer::Statistics MeshOptimizer::analyze(const std::vector<GLuint>& indices, size_t vertexCount, unsigned int cacheSize)
+{
+    Statistics statistics;
+    if (indices.empty() || vertexCount == 0) return statistics;
+
+    CacheSimulation cache(vertexCount, cacheSize);
+    size_t misses = 0;
+
+    for (GLuint index : indices) {
+        if (cache.access(index)) misses++;
+    }
+
+    statistics.acmr = static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+    statistics.atvr = static_cast<float>(misses) / static_cast<float>(vertexCount);
+    return statistics;
+}
+
+void MeshOptimizer::optimizeVertexCache(std::vector<GLuint>& indices, size_t vertexCount, unsigned int cacheSize)
+{
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) return;
+
+    // Triangles adjacent to every vertex, all lists packed in one array
+    std::vector<unsigned int> live(vertexCount, 0);
+    for (GLuint index : indices) live[index]++;
+
+    std::vector<unsigned int> offsets(vertexCount + 1, 0);
+    std::partial_sum(live.begin(), live.end(), offsets.begin() + 1);
+
+    std::vector<unsigned int> adjacency(indices.size());
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        for (int k = 0; k < 3; ++k) {
+            adjacency[fill[indices[t * 3 + k]]++] = static_cast<unsigned int>(t);
+        }
+    }
+
+    std::vector<unsigned int> stamps(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<GLuint> deadEnd, candidates, output;
+    output.reserve(indices.size());
+
+    unsigned int time = cacheSize + 1;
+    size_t cursor = 0;
+    long long fanning = indices.front();
+
+    while (fanning >= 0) {
+        candidates.clear();
+
+        // Emit every remaining triangle around the fanning vertex
+        for (unsigned int a = offsets[fanning]; a < offsets[fanning + 1]; ++a) {
+            unsigned int t = adjacency[a];
+            if (emitted[t]) continue;
+
+            for (int k = 0; k < 3; ++k) {
+                GLuint v = indices[t * 3 + k];
+                output.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+
+                if (time - stamps[v] > cacheSize) stamps[v] = time++;
+            }
+
+            emitted[t] = true;
+        }
+
+        // Next fanning vertex, prefer the oldest one that stays in the cache
+        // while its remaining triangles are emitted
+        fanning = -1;
+        long long priority = -1;
+
+        for (GLuint v : candidates) {
+            if (live[v] == 0) continue;
+
+            long long p = 0;
+            if (time - stamps[v] + 2 * live[v] <= cacheSize) p = time - stamps[v];
+
+            if (p > priority) {
+                priority = p;
+                fanning = v;
+            }
+        }
+
+        // Dead end, go back to recently used vertices first, then scan forward
+        while (fanning < 0 && !deadEnd.empty()) {
+            GLuint v = deadEnd.back();
+            deadEnd.pop_back();
+            if (live[v] > 0) fanning = v;
+        }
+
+        while (fanning < 0 && cursor < vertexCount) {
+            if (live[cursor] > 0) fanning = static_cast<long long>(cursor);
+            else cursor++;
+        }
+    }
+
+    indices = std::move(output);
+}
+
+void MeshOptimizer::optimizeOverdraw(std::vector<GLuint>& indices, const std::vector<Vertex>& vertices, float threshold, unsigned int cacheSize)
+{
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount < 2) return;
+
+    // Hard boundaries are the triangles missing the cache completely,
+    // Tipsify jumped to a new fan there, so cutting costs nothing.
+    std::vector<size_t> hard;
+    {
+        CacheSimulation cache(vertices.size(), cacheSize);
+        for (size_t t = 0; t < triangleCount; ++t) {
+            int misses = 0;
+            for (int k = 0; k < 3; ++k) misses += cache.access(indices[t * 3 + k]);
+            if (misses == 3) hard.push_back(t);
+        }
+        if (hard.empty() || hard.front() != 0) hard.insert(hard.begin(), 0);
+        hard.push_back(triangleCount);
+    }
+
+    // Soft boundaries split the hard clusters further, as long as starting
+    // with a cold cache keeps the cluster's ACMR within the threshold.
+    std::vector<size_t> clusters;
+    {
+        CacheSimulation cache(vertices.size(), cacheSize);
+
+        for (size_t h = 0; h + 1 < hard.size(); ++h) {
+            size_t begin = hard[h], end = hard[h + 1];
+
+            cache.reset();
+            size_t misses = 0;
+            for (size_t i = begin * 3; i < end * 3; ++i) misses += cache.access(indices[i]);
+            float limit = static_cast<float>(misses) / static_cast<float>(end - begin) * threshold;
+
+            cache.reset();
+            clusters.push_back(begin);
+            size_t start = begin;
+            misses = 0;
+
+            for (size_t t = begin; t + 1 < end; ++t) {
+                for (int k = 0; k < 3; ++k) misses += cache.access(indices[t * 3 + k]);
+
+                if (static_cast<float>(misses) / static_cast<float>(t + 1 - start) <= limit) {
+                    start = t + 1;
+                    misses = 0;
+                    cache.reset();
+                    clusters.push_back(start);
+                }
+            }
+        }
+        clusters.push_back(triangleCount);
+    }
+
+    // Area weighted centroid and normal of every cluster and of the whole mesh
+    const size_t clusterCount = clusters.size() - 1;
+    std::vector<glm::vec3> centroids(clusterCount, glm::vec3(0.0f)), directions(clusterCount, glm::vec3(0.0f));
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+
+    for (size_t c = 0; c < clusterCount; ++c) {
+        float clusterArea = 0.0f;
+
+        for (size_t t = clusters[c]; t < clusters[c + 1]; ++t) {
+            const glm::vec3& a = vertices[indices[t * 3 + 0]].Position;
+            const glm::vec3& b = vertices[indices[t * 3 + 1]].Position;
+            const glm::vec3& d = vertices[indices[t * 3 + 2]].Position;
+
+            glm::vec3 normal = glm::cross(b - a, d - a);
+            float area = glm::length(normal);
+
+            centroids[c] += (a + b + d) * (area / 3.0f);
+            directions[c] += normal;
+            clusterArea += area;
+        }
+
+        meshCentroid += centroids[c];
+        meshArea += clusterArea;
+        if (clusterArea > 0.0f) centroids[c] /= clusterArea;
+    }
+
+    if (meshArea > 0.0f) meshCentroid /= meshArea;
+
+    // Clusters facing away from the center are on the outside of the mesh
+    std::vector<float> keys(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++c) {
+        float length = glm::length(directions[c]);
+        keys[c] = length > 0.0f ? glm::dot(centroids[c] - meshCentroid, directions[c] / length) : 0.0f;
+    }
+
+    std::vector<size_t> order(clusterCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return keys[a] > keys[b]; });
+
+    std::vector<GLuint> output;
+    output.reserve(indices.size());
+    for (size_t c : order) {
+        output.insert(output.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+    }
+
+    indices = std::move(output);
+}
+
+void MeshOptimizer::optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<GLuint>& indices)
+{
+    const GLuint unused = std::numeric_limits<GLuint>::max();
+    std::vector<GLuint> remap(vertices.size(), unused);
+    std::vector<Vertex> output;
+    output.reserve(vertices.size());
+
+    for (GLuint& index : indices) {
+        if (remap[index] == unused) {
+            remap[index] = static_cast<GLuint>(output.size());
+            output.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    vertices = std::move(output);
+}
+
+std::vector<GLuint> MeshOptimizer::weldPositions(const std::vector<Vertex>& vertices, size_t& positionCount)
+{
+    std::vector<GLuint> order(vertices.size());
+    std::iota(order.begin(), order.end(), 0);
+
+    auto less = [&](GLuint a, GLuint b) {
+        const glm::vec3& p = vertices[a].Position;
+        const glm::vec3& q = vertices[b].Position;
+        if (p.x != q.x) return p.x < q.x;
+        if (p.y != q.y) return p.y < q.y;
+        return p.z < q.z;
+    };
+    std::sort(order.begin(), order.end(), less);
+
+    std::vector<GLuint> remap(vertices.size());
+    positionCount = 0;
+    for (size_t i = 0; i < order.size(); ++i) {
+        if (i > 0 && less(order[i - 1], order[i])) positionCount++;
+        remap[order[i]] = static_cast<GLuint>(positionCount);
+    }
+    if (!order.empty()) positionCount++;
+
+    return remap;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <vector>
+#include <GL/glew.h>
+
+#include "mesh.hpp"
+
+/*
+    Offline style optimizations of indexed triangle lists.
+    - none of them changes the rendered image, only the order of triangles and vertices
+*/
+class MeshOptimizer
+{
+public:
+    struct Statistics {
+        // Average cache miss ratio, transformed vertices per triangle (0.5 - 3.0)
+        float acmr = 0.0f;
+        // Average transformed to vertex ratio, transformed vertices per vertex (1.0 is optimal)
+        float atvr = 0.0f;
+    };
+
+    // Simulated post-transform cache, FIFO sized like on common hardware
+    static const unsigned int CACHE_SIZE = 16;
+
+    // Runs all the passes below in order and logs the statistics before and after.
+    static void optimize(MeshData& mesh);
+
+    static Statistics analyze(const std::vector<GLuint>& indices, size_t vertexCount, unsigned int cacheSize = CACHE_SIZE);
+
+    // Tipsify (Sander, Nehab, Barczak 2007), reorders triangles for the post-transform cache.
+    static void optimizeVertexCache(std::vector<GLuint>& indices, size_t vertexCount, unsigned int cacheSize = CACHE_SIZE);
+
+    // Splits the cache optimized order into clusters and sorts them outside-in, so that
+    // triangles likely to occlude others are drawn first. The threshold is the ACMR
+    // a cluster may lose compared to the input order (1.05 = 5% worse at most).
+    static void optimizeOverdraw(std::vector<GLuint>& indices, const std::vector<Vertex>& vertices, float threshold = 1.05f, unsigned int cacheSize = CACHE_SIZE);
+
+    // Reorders vertices in the order of their first use by the indices, unused vertices are dropped.
+    static void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<GLuint>& indices);
+
+    // Maps every vertex to an id shared by all vertices at the same position, vertices split
+    // by normals or UVs become neighbours again. Ids are dense, positionCount receives their number.
+    static std::vector<GLuint> weldPositions(const std::vector<Vertex>& vertices, size_t& positionCount);
+};
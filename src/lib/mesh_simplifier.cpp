@@ -0,0 +1,266 @@
+#include "mesh_simplifier.hpp"
+#include "mesh_optimizer.hpp"
+#include "logger.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+// Levels keeping more than this share of the triangles of the previous one are not worth a draw range
+static const float MIN_REDUCTION = 0.8f;
+
+// Smallest cosine between the normals of a triangle before and after a collapse
+static const double MAX_NORMAL_TURN = 0.2;
+
+/*
+    Sum of the squared distances to a set of planes, as the symmetric 4x4 matrix of
+    the plane equations. Planes are weighted by the area of their triangles.
+*/
+struct Quadric {
+    double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+    double a11 = 0, a12 = 0, a13 = 0;
+    double a22 = 0, a23 = 0;
+    double a33 = 0;
+    double weight = 0;
+
+    void addPlane(double nx, double ny, double nz, double d, double w) {
+        a00 += w * nx * nx; a01 += w * nx * ny; a02 += w * nx * nz; a03 += w * nx * d;
+        a11 += w * ny * ny; a12 += w * ny * nz; a13 += w * ny * d;
+        a22 += w * nz * nz; a23 += w * nz * d;
+        a33 += w * d * d;
+        weight += w;
+    }
+
+    Quadric& operator+=(const Quadric& other) {
+        a00 += other.a00; a01 += other.a01; a02 += other.a02; a03 += other.a03;
+        a11 += other.a11; a12 += other.a12; a13 += other.a13;
+        a22 += other.a22; a23 += other.a23;
+        a33 += other.a33;
+        weight += other.weight;
+        return *this;
+    }
+
+    // Mean squared distance of the point to the planes
+    double evaluate(const glm::vec3& point) const {
+        if (weight <= 0.0) return 0.0;
+
+        double x = point.x, y = point.y, z = point.z;
+        double sum = a00 * x * x + a11 * y * y + a22 * z * z + a33 +
+            2.0 * (a01 * x * y + a02 * x * z + a12 * y * z + a03 * x + a13 * y + a23 * z);
+        return std::max(sum, 0.0) / weight;
+    }
+};
+
+struct Collapse {
+    GLuint from;   // position that disappears
+    GLuint to;     // position it moves onto
+    GLuint vertex; // vertex of the target position the indices are redirected to
+    double cost;
+};
+
+static uint64_t edgeKey(GLuint a, GLuint b)
+{
+    return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+}
+
+static glm::vec3 faceNormal(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+    return glm::cross(b - a, c - a);
+}
+
+std::vector<GLuint> MeshSimplifier::simplify(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices, size_t targetIndexCount, float& error)
+{
+    error = 0.0f;
+
+    std::vector<GLuint> result = indices;
+    if (result.size() <= targetIndexCount || vertices.empty()) return result;
+
+    size_t positionCount;
+    std::vector<GLuint> position = MeshOptimizer::weldPositions(vertices, positionCount);
+
+    // A position may only move if a single vertex lives there and it is surrounded by
+    // triangles, seams and open borders would tear or shrink otherwise
+    std::vector<unsigned int> copies(positionCount, 0);
+    for (size_t v = 0; v < vertices.size(); ++v) copies[position[v]]++;
+
+    std::vector<bool> locked(positionCount, false);
+    for (size_t p = 0; p < positionCount; ++p) locked[p] = copies[p] > 1;
+
+    std::unordered_map<uint64_t, unsigned int> edgeUses;
+    for (size_t i = 0; i < result.size(); i += 3) {
+        for (int k = 0; k < 3; ++k) {
+            GLuint a = position[result[i + k]], b = position[result[i + (k + 1) % 3]];
+            if (a != b) edgeUses[edgeKey(a, b)]++;
+        }
+    }
+    for (const auto& [key, uses] : edgeUses) {
+        if (uses == 2) continue;
+        locked[key >> 32] = true;
+        locked[key & 0xFFFFFFFF] = true;
+    }
+
+    // One representative vertex per position is enough to read positions through ids
+    std::vector<GLuint> representative(positionCount);
+    for (size_t v = 0; v < vertices.size(); ++v) representative[position[v]] = static_cast<GLuint>(v);
+    auto point = [&](GLuint p) -> const glm::vec3& { return vertices[representative[p]].Position; };
+
+    std::vector<Quadric> quadrics(positionCount);
+    for (size_t i = 0; i < result.size(); i += 3) {
+        GLuint p0 = position[result[i]], p1 = position[result[i + 1]], p2 = position[result[i + 2]];
+        glm::vec3 normal = faceNormal(point(p0), point(p1), point(p2));
+        double length = glm::length(normal);
+        if (length == 0.0) continue;
+
+        double nx = normal.x / length, ny = normal.y / length, nz = normal.z / length;
+        double d = -(nx * point(p0).x + ny * point(p0).y + nz * point(p0).z);
+        double area = length * 0.5;
+
+        quadrics[p0].addPlane(nx, ny, nz, d, area);
+        quadrics[p1].addPlane(nx, ny, nz, d, area);
+        quadrics[p2].addPlane(nx, ny, nz, d, area);
+    }
+
+    const GLuint none = std::numeric_limits<GLuint>::max();
+    std::vector<GLuint> redirect(positionCount, none);
+    std::vector<bool> touched(positionCount, false);
+    std::vector<unsigned int> offsets(positionCount + 1), fill, adjacency;
+    std::vector<Collapse> collapses;
+
+    // Every pass collapses the cheapest edges whose neighbourhoods do not overlap
+    while (result.size() > targetIndexCount) {
+        const size_t triangleCount = result.size() / 3;
+
+        std::fill(offsets.begin(), offsets.end(), 0);
+        for (GLuint index : result) offsets[position[index] + 1]++;
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+        adjacency.resize(result.size());
+        fill.assign(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < result.size(); ++i) adjacency[fill[position[result[i]]]++] = static_cast<unsigned int>(i / 3);
+
+        // Every inner edge shows up once in each direction, from its two triangles
+        collapses.clear();
+        for (size_t i = 0; i < result.size(); i += 3) {
+            for (int k = 0; k < 3; ++k) {
+                GLuint from = position[result[i + k]];
+                GLuint vertex = result[i + (k + 1) % 3];
+                GLuint to = position[vertex];
+                if (from == to || locked[from]) continue;
+
+                Quadric combined = quadrics[from];
+                combined += quadrics[to];
+                collapses.push_back(Collapse{ from, to, vertex, combined.evaluate(point(to)) });
+            }
+        }
+
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+        std::fill(touched.begin(), touched.end(), false);
+        size_t excess = (result.size() - targetIndexCount) / 3;
+        size_t removed = 0;
+        size_t applied = 0;
+
+        for (const Collapse& collapse : collapses) {
+            if (removed >= excess) break;
+            if (touched[collapse.from] || touched[collapse.to]) continue;
+
+            // Triangles around the moving position must not fold over or collapse to a line
+            bool valid = true;
+            size_t shared = 0;
+
+            for (unsigned int a = offsets[collapse.from]; a < offsets[collapse.from + 1] && valid; ++a) {
+                const size_t t = adjacency[a];
+                GLuint corners[3] = { position[result[3 * t]], position[result[3 * t + 1]], position[result[3 * t + 2]] };
+
+                if (corners[0] == collapse.to || corners[1] == collapse.to || corners[2] == collapse.to) {
+                    shared++;
+                    continue;
+                }
+
+                glm::vec3 before = faceNormal(point(corners[0]), point(corners[1]), point(corners[2]));
+                for (GLuint& corner : corners) {
+                    if (corner == collapse.from) corner = collapse.to;
+                }
+                glm::vec3 after = faceNormal(point(corners[0]), point(corners[1]), point(corners[2]));
+
+                double lengths = double(glm::length(before)) * double(glm::length(after));
+                valid = lengths > 0.0 && glm::dot(before, after) >= MAX_NORMAL_TURN * lengths;
+            }
+
+            if (!valid) continue;
+
+            // The whole neighbourhood waits for the next pass, its triangles change shape
+            for (unsigned int a = offsets[collapse.from]; a < offsets[collapse.from + 1]; ++a) {
+                const size_t t = adjacency[a];
+                for (int k = 0; k < 3; ++k) touched[position[result[3 * t + k]]] = true;
+            }
+            touched[collapse.to] = true;
+
+            redirect[collapse.from] = collapse.vertex;
+            quadrics[collapse.to] += quadrics[collapse.from];
+            error = std::max(error, static_cast<float>(std::sqrt(collapse.cost)));
+
+            removed += shared;
+            applied++;
+        }
+
+        if (applied == 0) break;
+
+        // Redirect the indices and drop the triangles that lost their area
+        size_t write = 0;
+        for (size_t t = 0; t < triangleCount; ++t) {
+            GLuint triangle[3];
+            for (int k = 0; k < 3; ++k) {
+                GLuint index = result[3 * t + k];
+                GLuint target = redirect[position[index]];
+                triangle[k] = target != none ? target : index;
+            }
+
+            GLuint p0 = position[triangle[0]], p1 = position[triangle[1]], p2 = position[triangle[2]];
+            if (p0 == p1 || p1 == p2 || p0 == p2) continue;
+
+            result[write++] = triangle[0];
+            result[write++] = triangle[1];
+            result[write++] = triangle[2];
+        }
+        result.resize(write);
+
+        std::fill(redirect.begin(), redirect.end(), none);
+    }
+
+    return result;
+}
+
+void MeshSimplifier::generateLods(MeshData& mesh, size_t levels)
+{
+    const uint32_t fullCount = static_cast<uint32_t>(mesh.indices.size());
+
+    mesh.lods.clear();
+    mesh.lods.push_back(MeshLod{ 0, fullCount, 0.0f });
+    if (fullCount == 0) return;
+
+    // Every level starts from the full mesh, so the errors are measured against the original surface
+    const std::vector<GLuint> full(mesh.indices.begin(), mesh.indices.end());
+    std::string summary = std::to_string(fullCount / 3);
+
+    for (size_t level = 1; level <= levels; ++level) {
+        size_t target = (fullCount / 3 >> level) * 3;
+
+        float error;
+        std::vector<GLuint> lod = simplify(mesh.vertices, full, target, error);
+
+        if (lod.empty() || lod.size() > mesh.lods.back().indexCount * MIN_REDUCTION) break;
+
+        MeshOptimizer::optimizeVertexCache(lod, mesh.vertices.size());
+
+        mesh.lods.push_back(MeshLod{ static_cast<uint32_t>(mesh.indices.size()), static_cast<uint32_t>(lod.size()), error });
+        mesh.indices.insert(mesh.indices.end(), lod.begin(), lod.end());
+
+        summary += " -> " + std::to_string(lod.size() / 3) + " (" + std::to_string(error) + ")";
+    }
+
+    Logger::debug("Levels of detail of mesh " + mesh.material.name + ": " + summary + " triangles");
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include <GL/glew.h>
+
+#include "mesh.hpp"
+
+/*
+    Quadric error metric simplifier (Garland, Heckbert 1997) working on the index buffer only.
+    - edges collapse onto one of their existing vertices, so every level shares the vertex buffer
+    - positions on attribute seams or open borders are kept, the silhouette and the UV layout stay intact
+    - the error is the RMS distance to the planes of the original triangles, in model units
+*/
+class MeshSimplifier
+{
+public:
+    // Levels generated below the full mesh, each one with about half the triangles of the previous
+    static const size_t LOD_COUNT = 3;
+
+    // Returns the indices reduced towards targetIndexCount and the error of the result.
+    // Stops early when no collapse is left that keeps the surface from folding over.
+    static std::vector<GLuint> simplify(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices, size_t targetIndexCount, float& error);
+
+    // Appends the levels to mesh.indices and fills mesh.lods, the first level being the full mesh.
+    // Levels that would not remove a meaningful share of the previous one are not kept.
+    static void generateLods(MeshData& mesh, size_t levels = LOD_COUNT);
+};
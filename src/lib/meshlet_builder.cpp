@@ -0,0 +1,214 @@
+#include "meshlet_builder.hpp"
+#include "mesh_optimizer.hpp"
+#include "logger.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+// Unassigned triangles looked at when a cluster runs out of neighbours
+static const size_t FALLBACK_WINDOW = 256;
+
+void MeshletBuilder::build(MeshData& mesh, size_t maxTriangles)
+{
+    mesh.meshlets.clear();
+
+    const std::vector<GLuint>& indices = mesh.indices;
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0 || maxTriangles == 0) return;
+
+    // Seams in normals or UVs do not split clusters, adjacency goes through positions
+    size_t positionCount;
+    std::vector<GLuint> remap = MeshOptimizer::weldPositions(mesh.vertices, positionCount);
+
+    // Triangles around every position, compressed rows
+    std::vector<uint32_t> offsets(positionCount + 1, 0);
+    for (GLuint index : indices) offsets[remap[index] + 1]++;
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); ++i) adjacency[fill[remap[indices[i]]]++] = static_cast<uint32_t>(i / 3);
+
+    // Degenerate triangles get a zero normal and fit into any cluster
+    std::vector<glm::vec3> normals(triangleCount);
+    std::vector<glm::vec3> centroids(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        const glm::vec3& a = mesh.vertices[indices[3 * t + 0]].Position;
+        const glm::vec3& b = mesh.vertices[indices[3 * t + 1]].Position;
+        const glm::vec3& c = mesh.vertices[indices[3 * t + 2]].Position;
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float length = glm::length(normal);
+        normals[t] = length > 0.0f ? normal / length : glm::vec3(0.0f);
+        centroids[t] = (a + b + c) / 3.0f;
+    }
+
+    const uint32_t none = std::numeric_limits<uint32_t>::max();
+    std::vector<bool> assigned(triangleCount, false);
+    std::vector<uint32_t> positionOwner(positionCount, none);  // last cluster that used the position
+    std::vector<uint32_t> candidateOwner(triangleCount, none); // last cluster that listed the triangle
+
+    std::vector<GLuint> reordered;
+    reordered.reserve(indices.size());
+
+    std::vector<uint32_t> triangles;
+    std::vector<uint32_t> candidates;
+    size_t seed = 0;
+
+    for (uint32_t cluster = 0;; ++cluster) {
+        // Seeds follow the input order, which is spatially coherent after the cache optimization
+        while (seed < triangleCount && assigned[seed]) seed++;
+        if (seed == triangleCount) break;
+
+        triangles.clear();
+        candidates.clear();
+        glm::vec3 normalSum(0.0f);
+        glm::vec3 centroidSum(0.0f);
+        uint32_t next = static_cast<uint32_t>(seed);
+
+        while (next != none) {
+            assigned[next] = true;
+            triangles.push_back(next);
+            normalSum += normals[next];
+            centroidSum += centroids[next];
+
+            for (int corner = 0; corner < 3; ++corner) {
+                uint32_t position = remap[indices[3 * next + corner]];
+                if (positionOwner[position] == cluster) continue;
+                positionOwner[position] = cluster;
+
+                for (uint32_t i = offsets[position]; i < offsets[position + 1]; ++i) {
+                    uint32_t neighbour = adjacency[i];
+                    if (assigned[neighbour] || candidateOwner[neighbour] == cluster) continue;
+                    candidateOwner[neighbour] = cluster;
+                    candidates.push_back(neighbour);
+                }
+            }
+
+            if (triangles.size() >= maxTriangles) break;
+
+            float length = glm::length(normalSum);
+            glm::vec3 axis = length > 0.0f ? normalSum / length : glm::vec3(0.0f);
+
+            // Fewest new corners first, a turning normal costs up to one corner
+            next = none;
+            float bestScore = std::numeric_limits<float>::max();
+
+            for (size_t i = 0; i < candidates.size();) {
+                uint32_t candidate = candidates[i];
+                if (assigned[candidate]) {
+                    candidates[i] = candidates.back();
+                    candidates.pop_back();
+                    continue;
+                }
+
+                int added = 0;
+                for (int corner = 0; corner < 3; ++corner) {
+                    if (positionOwner[remap[indices[3 * candidate + corner]]] != cluster) added++;
+                }
+
+                float score = added + (1.0f - glm::dot(normals[candidate], axis)) * 0.5f;
+                if (score < bestScore) {
+                    bestScore = score;
+                    next = candidate;
+                }
+                ++i;
+            }
+
+            // Scenes built from many small disconnected pieces would end up with tiny clusters,
+            // those continue with the closest of the next few triangles in input order until
+            // they are half full. Bigger ones stop, a spread out cluster culls badly.
+            if (next == none && triangles.size() < maxTriangles / 2) {
+                glm::vec3 center = centroidSum / static_cast<float>(triangles.size());
+                float bestDistance = std::numeric_limits<float>::max();
+
+                size_t scanned = 0;
+                for (size_t t = seed; t < triangleCount && scanned < FALLBACK_WINDOW; ++t) {
+                    if (assigned[t]) continue;
+                    scanned++;
+
+                    float distance = glm::length(centroids[t] - center);
+                    if (distance < bestDistance) {
+                        bestDistance = distance;
+                        next = static_cast<uint32_t>(t);
+                    }
+                }
+            }
+        }
+
+        // Input order inside the cluster, the vertex cache keeps most of its hits
+        std::sort(triangles.begin(), triangles.end());
+
+        Meshlet meshlet{};
+        meshlet.indexOffset = static_cast<uint32_t>(reordered.size());
+        meshlet.indexCount = static_cast<uint32_t>(triangles.size() * 3);
+        for (uint32_t triangle : triangles) {
+            reordered.insert(reordered.end(), indices.begin() + 3 * triangle, indices.begin() + 3 * triangle + 3);
+        }
+
+        mesh.meshlets.push_back(meshlet);
+    }
+
+    mesh.indices = std::move(reordered);
+
+    size_t culled = 0;
+    for (Meshlet& meshlet : mesh.meshlets) {
+        calculateBounds(meshlet, mesh.indices, mesh.vertices);
+        if (meshlet.coneCutoff < 1.0f) culled++;
+    }
+
+    Logger::debug("Built " + std::to_string(mesh.meshlets.size()) + " meshlets for mesh " + mesh.material.name +
+        ", " + std::to_string(culled) + " of them with a usable normal cone");
+}
+
+void MeshletBuilder::calculateBounds(Meshlet& meshlet, const std::vector<GLuint>& indices, const std::vector<Vertex>& vertices)
+{
+    const uint32_t end = meshlet.indexOffset + meshlet.indexCount;
+
+    // Sphere around the box center, slightly larger than the minimal one but cheap and stable
+    glm::vec3 low(std::numeric_limits<float>::max()), high(std::numeric_limits<float>::lowest());
+    for (uint32_t i = meshlet.indexOffset; i < end; ++i) {
+        low = glm::min(low, vertices[indices[i]].Position);
+        high = glm::max(high, vertices[indices[i]].Position);
+    }
+
+    meshlet.center = (low + high) * 0.5f;
+    meshlet.radius = 0.0f;
+    for (uint32_t i = meshlet.indexOffset; i < end; ++i) {
+        meshlet.radius = std::max(meshlet.radius, glm::length(vertices[indices[i]].Position - meshlet.center));
+    }
+
+    // Cone axis is the average face normal, its angle the widest one to any face
+    std::vector<glm::vec3> normals;
+    normals.reserve(meshlet.indexCount / 3);
+
+    glm::vec3 sum(0.0f);
+    for (uint32_t i = meshlet.indexOffset; i + 2 < end; i += 3) {
+        const glm::vec3& a = vertices[indices[i + 0]].Position;
+        const glm::vec3& b = vertices[indices[i + 1]].Position;
+        const glm::vec3& c = vertices[indices[i + 2]].Position;
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float length = glm::length(normal);
+        if (length == 0.0f) continue;
+
+        normals.push_back(normal / length);
+        sum += normals.back();
+    }
+
+    meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    meshlet.coneCutoff = 1.0f;
+
+    float length = glm::length(sum);
+    if (normals.empty() || length == 0.0f) return;
+
+    glm::vec3 axis = sum / length;
+    float minimum = 1.0f;
+    for (const glm::vec3& normal : normals) minimum = std::min(minimum, glm::dot(normal, axis));
+
+    // Faces past 90 degrees from the axis are visible from every side
+    if (minimum <= 0.0f) return;
+
+    meshlet.coneAxis = axis;
+    meshlet.coneCutoff = std::sqrt(1.0f - minimum * minimum);
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+#include "mesh.hpp"
+
+/*
+    Splits indexed triangle lists into clusters (meshlets) the renderer can cull one by one.
+    - clusters grow over shared positions, preferring triangles that add few new corners
+      and keep the normals together, so their spheres stay small and their cones narrow
+    - the index buffer is reordered so that every cluster is a contiguous range, triangles
+      inside a cluster keep their relative order and with it most of the cache optimization
+*/
+class MeshletBuilder
+{
+public:
+    static const size_t MAX_TRIANGLES = 128;
+
+    // Fills mesh.meshlets and reorders mesh.indices to match them.
+    static void build(MeshData& mesh, size_t maxTriangles = MAX_TRIANGLES);
+
+    // Bounding sphere and normal cone of the triangles of a cluster
+    static void calculateBounds(Meshlet& meshlet, const std::vector<GLuint>& indices, const std::vector<Vertex>& vertices);
+};
@@ -5,31 +5,22 @@
 #include "render.hpp"
 #include "model.hpp"
 #include "logger.hpp"
-#include "obj_loader.hpp"
+#include "frustum_culler.hpp"
+#include <algorithm>
+#include <cmath>
 #include <limits>
 
-Model::Model(const std::filesystem::path& filename)
+float Model::lodThreshold = 1.0f;
+
+Model::Model(const std::filesystem::path& filename, const ImportSettings& settings, const std::shared_ptr<LoadProgress>& progress)
 {
 	this->transform = glm::mat4(1.0f);
-	this->meshes = std::vector<Mesh>{};
-
-	auto suffix = filename.extension().string();
-
-	if (suffix == ".obj") {
-		auto loader = OBJLoader(filename);
-
-		for (Mesh mesh : loader.submeshes) {
-			meshes.push_back(mesh);
-		}
-	}
-	else {
-		Logger::error("Unrecognized file extension: " + suffix);
-	};
+	this->asset = AssetRegistry::model(filename, settings, progress);
 }
 
 Model::Model(const Model& copy)
 {
-	this->meshes = copy.meshes;
+	this->asset = copy.asset;
 	this->transform = glm::mat4(1.0f);
 }
 
@@ -39,39 +30,100 @@ Model::Model()
 
 AABB Model::calculateAABB()
 {
-    glm::vec3 minBound(std::numeric_limits<float>::max());
-    glm::vec3 maxBound(std::numeric_limits<float>::lowest());
-
-    for (const auto& mesh : meshes)
-    {
-        for (const auto& vertex : mesh.vertices)
-        {
-            // We transform the local vertex position into world space 
-            // using the model's current transform matrix.
-            glm::vec4 worldPos = transform * glm::vec4(vertex.Position, 1.0f);
-
-            minBound.x = std::min(minBound.x, worldPos.x);
-            minBound.y = std::min(minBound.y, worldPos.y);
-            minBound.z = std::min(minBound.z, worldPos.z);
-
-            maxBound.x = std::max(maxBound.x, worldPos.x);
-            maxBound.y = std::max(maxBound.y, worldPos.y);
-            maxBound.z = std::max(maxBound.z, worldPos.z);
+    if (!asset || asset->meshes.empty()) {
+        return AABB{ glm::vec3(std::numeric_limits<float>::max()), glm::vec3(std::numeric_limits<float>::lowest()) };
+    }
+
+    // Meshes of an asset still loading keep appearing
+    if (boundsMeshes != asset->meshes.size()) {
+        boundsMeshes = asset->meshes.size();
+        localBounds = asset->meshes.front().bounds;
+
+        for (const auto& mesh : asset->meshes) {
+            localBounds.min = glm::min(localBounds.min, mesh.bounds.min);
+            localBounds.max = glm::max(localBounds.max, mesh.bounds.max);
         }
+        boundsValid = false;
     }
-    return AABB{ minBound, maxBound };
+
+    if (!boundsValid || boundsTransform != transform) {
+        worldBounds = localBounds.transformed(transform);
+        boundsTransform = transform;
+        boundsValid = true;
+    }
+
+    return worldBounds;
 }
 
-void Model::submit(Shader& shader)
+size_t Model::selectLod(const Mesh& mesh, float distance, float scale) const
 {
-   float dist = glm::distance(Renderer::camera->Position, glm::vec3(transform[3]));
+    if (mesh.lods.size() <= 1 || lodThreshold <= 0.0f) return 0;
+
+    // The distance is measured to the origin, parts of a large mesh may be a lot closer
+    float reach = (glm::length(mesh.sphere.center) + mesh.sphere.radius) * scale;
+    float nearest = std::max(distance - reach, 0.1f);
+
+    // Pixels covered by one unit at the nearest point
+    float fov = glm::radians(Renderer::camera->FOV);
+    float pixels = Renderer::getHeight() / (2.0f * std::tan(fov * 0.5f) * nearest);
+
+    for (size_t lod = mesh.lods.size() - 1; lod > 0; --lod) {
+        if (mesh.lods[lod].error * scale * pixels <= lodThreshold) return lod;
+    }
+    return 0;
+}
 
-    for (Mesh& mesh : meshes) {
-        RenderCommand cmd = { &mesh, transform, dist };
+void Model::submit(ShaderVariants& shaders)
+{
+    if (!asset) return;
+
+    float dist = glm::distance(Renderer::camera->Position, glm::vec3(transform[3]));
+
+    // Largest axis scale, errors are measured in model units
+    float scale = std::max({ glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2])) });
+
+    const size_t meshCount = asset->meshes.size();
+
+    // The cached bounds of the whole model reject it in one test
+    if (!FrustumCuller::intersects(Renderer::frustum, calculateAABB())) {
+        Renderer::statistics.culled += meshCount;
+        return;
+    }
+
+    // Only ever filled on the render thread, kept to avoid allocating every submit
+    static std::vector<AABB> boxes;
+    static std::vector<uint8_t> visible;
+    boxes.clear();
+    visible.assign(meshCount, 1);
+
+    if (meshCount > 1) {
+        for (const Mesh& mesh : asset->meshes) boxes.push_back(mesh.bounds.transformed(transform));
+        FrustumCuller::test(Renderer::frustum, boxes.data(), meshCount, visible.data());
+    }
+
+    for (size_t i = 0; i < meshCount; ++i) {
+        if (!visible[i]) {
+            Renderer::statistics.culled++;
+            continue;
+        }
+        Renderer::statistics.visible++;
+
+        const Mesh& mesh = asset->meshes[i];
+        RenderCommand cmd = { &mesh, transform, dist, selectLod(mesh, dist, scale) };
+        GLuint texture = mesh.material.texture.id != -1 ? static_cast<GLuint>(mesh.material.texture.id) : 0;
+
+        // Meshes appear only once their texture is final, the variant is TEXTURED exactly
+        // when the texture of the material was uploaded
+        cmd.features = mesh.material.texture.id != -1 ? ShaderVariants::TEXTURED : 0;
         
+        // See-through surfaces hide nothing
+        if (occluder && mesh.material.transparency >= 1.0f) Renderer::queue.occluders.push_back(cmd);
+
         if (mesh.material.transparency < 1.0f) {
+            cmd.key = SortKey::transparent(texture, mesh.vertexArray(), dist);
             Renderer::queue.transparent.push_back(cmd);
         } else {
+            cmd.key = SortKey::opaque(shaders.get(cmd.features).ID, texture, mesh.vertexArray(), dist);
             Renderer::queue.opaque.push_back(cmd);
         }
     }
@@ -7,18 +7,40 @@
 
 #include "camera.hpp"
 #include "mesh.hpp"
+#include "obj_loader.hpp"
+#include "asset_registry.hpp"
+#include "shader_variants.hpp"
 
 class Model
 {
 public:
+	// Screen space error in pixels a level of detail may have, 0 always draws the full meshes
+	static float lodThreshold;
+
 	glm::mat4 transform;
-	std::vector<Mesh> meshes;
+	// Large and solid, hides what is behind it from the occlusion culling
+	bool occluder = false;
+	// Shared by every model loaded from the same file, may be null
+	std::shared_ptr<const ModelAsset> asset;
 
-	Model(const std::filesystem::path& filename);
+	// Returns right away, the meshes appear once AssetRegistry::update uploads them
+	Model(const std::filesystem::path& filename, const ImportSettings& settings = ImportSettings{}, const std::shared_ptr<LoadProgress>& progress = nullptr);
 	Model(const Model& copy);
 	Model();
 
-	void submit(Shader& shader);
+	void submit(ShaderVariants& shaders);
+	// World space bounds, recomputed only when the transform or the loaded meshes change
 	AABB calculateAABB();
+
+private:
+	// Union of the local bounds of the meshes and the world bounds it was last transformed into
+	AABB localBounds{ glm::vec3(0.0f), glm::vec3(0.0f) };
+	AABB worldBounds{ glm::vec3(0.0f), glm::vec3(0.0f) };
+	glm::mat4 boundsTransform{ 0.0f };
+	size_t boundsMeshes = 0;
+	bool boundsValid = false;
+
+	// Coarsest level of the mesh whose error stays under lodThreshold pixels at the distance
+	size_t selectLod(const Mesh& mesh, float distance, float scale) const;
 };
 
@@ -1,76 +1,210 @@
-#include <opencv2/opencv.hpp>
 #include <sstream>
 #include <numeric>
+#include <thread>
 
 #include "logger.hpp"
 #include "vertex.hpp"
 #include "material.hpp"
 #include "mesh.hpp"
+#include "mesh_optimizer.hpp"
+#include "meshlet_builder.hpp"
+#include "mesh_simplifier.hpp"
+#include "mapped_file.hpp"
 #include "obj_loader.hpp"
 #include "string_utils.hpp"
 
 struct MeshContainer {
-	std::vector< unsigned int > vertices;
-	std::vector< unsigned int > uvs;
-	std::vector< unsigned int > normals;
+	// (vertex, uv, normal) indices of every face corner, 1-based, 0 if missing
+	std::vector< glm::ivec3 > corners;
 	Material material;
 };
 
-OBJLoader::OBJLoader(const std::filesystem::path& modelFilename)
+// Geometry of a continuous range of lines of an OBJ file.
+// Positive face indices are absolute, relative (negative) indices are resolved
+// against the chunk's own arrays and listed so they can be offset when merging.
+struct ObjChunk {
+	std::vector< glm::vec3 > vertices;
+	std::vector< glm::vec2 > uvs;
+	std::vector< glm::vec3 > normals;
+	std::vector< glm::ivec3 > corners;
+
+	// corner * 3 + component of every relative index
+	std::vector< size_t > relative;
+	// usemtl names and the first corner that uses them
+	std::vector< std::pair<std::string_view, size_t> > materials;
+	// arguments of mtllib lines
+	std::vector< std::string_view > libraries;
+};
+
+struct CornerHash {
+	size_t operator()(const glm::ivec3& corner) const {
+		// Indices are small, mixing them with large odd constants spreads them well enough
+		size_t hash = static_cast<uint32_t>(corner[0]) * 0x9E3779B1u;
+		hash ^= static_cast<uint32_t>(corner[1]) * 0x85EBCA77u + (hash << 6) + (hash >> 2);
+		hash ^= static_cast<uint32_t>(corner[2]) * 0xC2B2AE3Du + (hash << 6) + (hash >> 2);
+		return hash;
+	}
+};
+
+// Reads the next whitespace delimited float of the line.
+// Missing or malformed values leave the output untouched.
+static bool readFloat(std::string_view& input, float& output)
+{
+	std::string_view token = nextToken(input);
+	return parseNumber(token, output);
+}
+
+// Moves the source at the end of the destination.
+template <typename T>
+static void append(std::vector<T>& destination, std::vector<T>& source)
+{
+	if (destination.empty()) destination = std::move(source);
+	else destination.insert(destination.end(), source.begin(), source.end());
+}
+
+// Parses every line of the text into the chunk.
+static void parseChunk(std::string_view text, ObjChunk& chunk)
+{
+	while (!text.empty()) {
+		std::string_view line = nextLine(text);
+		// Get the line header, the line is left with the arguments only
+		std::string_view header = nextToken(line);
+
+		// Empty lines and comments
+		if (header.empty() || header.front() == '#') continue;
+		// Texture definition
+		else if (header == "mtllib") chunk.libraries.push_back(line);
+		// Vertices definition
+		else if (header == "v") OBJLoader::Parse::vertex(line, chunk.vertices);
+		// UVs definition
+		else if (header == "vt") OBJLoader::Parse::uv(line, chunk.uvs);
+		// Normals definition
+		else if (header == "vn") OBJLoader::Parse::normal(line, chunk.normals);
+		// Faces
+		else if (header == "f") {
+			size_t first = chunk.corners.size();
+			OBJLoader::Parse::face(line, chunk.corners);
+
+			const glm::ivec3 counts(chunk.vertices.size(), chunk.uvs.size(), chunk.normals.size());
+			for (size_t i = first; i < chunk.corners.size(); ++i) {
+				for (int j = 0; j < 3; ++j) {
+					if (chunk.corners[i][j] >= 0) continue;
+
+					// -1 is the last element defined so far
+					chunk.corners[i][j] += counts[j] + 1;
+					chunk.relative.push_back(i * 3 + j);
+				}
+			}
+		}
+		// Material switch
+		else if (header == "usemtl") chunk.materials.push_back({ nextToken(line), chunk.corners.size() });
+	}
+}
+
+// Splits the text at line boundaries into at most 'count' chunks,
+// parses them on worker threads and returns them in the file order.
+static std::vector<ObjChunk> parseParallel(std::string_view text, unsigned int count)
 {
-	std::vector<glm::vec3> temp_vertices;
-	std::vector<glm::vec2> temp_uvs;
-	std::vector<glm::vec3> temp_normals;
+	std::vector<std::string_view> ranges;
+	for (unsigned int i = count; i > 1; --i) {
+		size_t split = text.find('\n', text.size() / i);
+		if (split == std::string_view::npos) break;
+
+		ranges.push_back(text.substr(0, split + 1));
+		text.remove_prefix(split + 1);
+	}
+	ranges.push_back(text);
+
+	std::vector<ObjChunk> chunks(ranges.size());
+	std::vector<std::thread> workers;
+
+	for (size_t i = 1; i < ranges.size(); ++i) {
+		workers.emplace_back(parseChunk, ranges[i], std::ref(chunks[i]));
+	}
 
+	// The calling thread takes the first chunk
+	parseChunk(ranges[0], chunks[0]);
+
+	for (auto& worker : workers) {
+		worker.join();
+	}
+
+	return chunks;
+}
+
+OBJLoader::OBJLoader(const std::filesystem::path& modelFilename, const ImportSettings& settings)
+{
 	std::vector<MeshContainer> parts;
 	auto basic = MeshContainer();
 	parts.push_back(basic);
 
 	Logger::info("Loading " + modelFilename.string());
 
-	std::ifstream file(modelFilename);
-	if (!file.is_open()) {
+	// The whole file is mapped and walked in place,
+	// lines and tokens are only views into the mapping.
+	MappedFile file(modelFilename);
+	if (!file.isOpen()) {
 		Logger::error("File " + modelFilename.string() + " does not exist!");
 		return;
 	}
 
-	std::string line;
-	while (std::getline(file, line)) {
-		std::vector<std::string> tokens = split(line, ' ');
+	unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<ObjChunk> chunks;
 
-		// If the line is empty for some reason, we skip it.
-		// This should not happen, but better be safe than sorry.
-		if (tokens.empty()) continue;
+	if (settings.parallel && threads > 1 && file.size() >= settings.parallelThreshold) {
+		chunks = parseParallel(file.view(), threads);
+		Logger::debug("Parsed in " + std::to_string(chunks.size()) + " chunks");
+	}
+	else {
+		chunks.resize(1);
+		parseChunk(file.view(), chunks.front());
+	}
+
+	// Materials have to be known before any part can reference them
+	for (const ObjChunk& chunk : chunks) {
+		for (std::string_view library : chunk.libraries) {
+			std::string_view arguments = library;
+			std::string_view name = nextToken(arguments);
+			if (!name.empty()) libraries.push_back(modelFilename.parent_path() / name);
+
+			OBJLoader::Parse::MTL(library, modelFilename.parent_path(), materials);
+		}
+	}
+
+	// Merge the chunks in order, offsetting the relative indices
+	// by the amount of elements defined in the preceding chunks.
+	for (ObjChunk& chunk : chunks) {
+		const glm::ivec3 base(vertices.size(), uvs.size(), normals.size());
+		for (size_t r : chunk.relative) {
+			chunk.corners[r / 3][r % 3] += base[r % 3];
+		}
+
+		append(vertices, chunk.vertices);
+		append(uvs, chunk.uvs);
+		append(normals, chunk.normals);
+
+		size_t begin = 0;
+		for (const auto& [name, offset] : chunk.materials) {
+			auto& corners = parts.back().corners;
+			corners.insert(corners.end(), chunk.corners.begin() + begin, chunk.corners.begin() + offset);
+			begin = offset;
 
-		// Get the line header
-		std::string header = tokens.front();
-		// Remove it from the token list
-		tokens.erase(tokens.begin());
-		
-		// Comments
-		if (header == "#") continue;
-		// Texture definition
-		else if (header == "mtllib") OBJLoader::Parse::MTL(tokens, modelFilename.parent_path().string(), materials);
-		// Vertices definition
-		else if (header == "v") OBJLoader::Parse::vertex(tokens, temp_vertices);
-		// UVs definition
-		else if (header == "vt") OBJLoader::Parse::uv(tokens, temp_uvs);
-		// Normals definition
-		else if (header == "vn") OBJLoader::Parse::normal(tokens, temp_normals);
-		// Faces
-		else if (header == "f") OBJLoader::Parse::face(tokens, parts.back().vertices, parts.back().uvs, parts.back().normals);
-		//TODO
-		else if (header == "usemtl") {
-			// Here we cope that the material exists
-			// TODO: Handle errors here
-			auto material = materials[tokens[0]];
 			auto test = MeshContainer();
-			test.material = material;
+			auto material = materials.find(std::string(name));
+			if (material != materials.end()) {
+				test.material = material->second;
+			}
+			else {
+				Logger::warning("Material " + std::string(name) + " is not defined in any MTL file.");
+			}
 
-			Logger::debug("Creating Material Submesh: " + tokens[0]);
+			Logger::debug("Creating Material Submesh: " + std::string(name));
 
 			parts.push_back(test);
 		}
+
+		auto& corners = parts.back().corners;
+		corners.insert(corners.end(), chunk.corners.begin() + begin, chunk.corners.end());
 	}
 
 	std::ostringstream statistics, mat;
@@ -78,9 +212,9 @@ OBJLoader::OBJLoader(const std::filesystem::path& modelFilename)
 	Logger::info("Parsed model " + modelFilename.string());
 	Logger::info("Model Parts: " + std::to_string(parts.size()));
 
-	statistics << "Vertices: " << temp_vertices.size() << ", ";
-	statistics << "UVs: " << temp_uvs.size() << ", ";
-	statistics << "Normals: " << temp_normals.size();
+	statistics << "Vertices: " << vertices.size() << ", ";
+	statistics << "UVs: " << uvs.size() << ", ";
+	statistics << "Normals: " << normals.size();
 
 	for (auto i = materials.begin(); i != materials.end(); ++i) {
 		mat << i->first << " ";
@@ -89,31 +223,40 @@ OBJLoader::OBJLoader(const std::filesystem::path& modelFilename)
 	Logger::debug("Model Primitives: \t" + statistics.str());
 	Logger::debug("Model Materials: \t" + mat.str());
 
-	for (MeshContainer mesh : parts) {
-		if (mesh.vertices.empty()) continue;
+	for (const MeshContainer& mesh : parts) {
+		if (mesh.corners.empty()) continue;
 
 		//Hey, i know it's spelled wrong.
 		//But I've vertices already defined.
 		std::vector<Vertex> vertexes;
 		std::vector< GLuint > indices;
+		indices.reserve(mesh.corners.size());
+
+		// Corners referencing the same (vertex, uv, normal) triple
+		// are welded into one vertex, the rest is done by the index buffer.
+		std::unordered_map<glm::ivec3, GLuint, CornerHash> welded;
+		welded.reserve(mesh.corners.size());
+
+		for (const glm::ivec3& corner : mesh.corners) {
+			auto [entry, inserted] = welded.try_emplace(corner, static_cast<GLuint>(vertexes.size()));
+			indices.push_back(entry->second);
 
-		// unroll from indirect to direct vertex specification
-		// sometimes not necessary, definitely not optimal
-		for (unsigned int u = 0; u < mesh.vertices.size(); u++) {
-			Vertex vertex;
-			unsigned int vertexIndex = mesh.vertices[u];
-			unsigned int uvIndex = mesh.uvs[u];
-			unsigned int normalIndex = mesh.normals[u];
+			if (!inserted) continue;
+
+			Vertex vertex{};
+			unsigned int vertexIndex = corner[0];
+			unsigned int uvIndex = corner[1];
+			unsigned int normalIndex = corner[2];
 
 			// Getting vertices
-			if (vertexIndex - 1 < temp_vertices.size()) {
-				glm::vec3 position = temp_vertices[vertexIndex - 1];
+			if (vertexIndex - 1 < vertices.size()) {
+				glm::vec3 position = vertices[vertexIndex - 1];
 				vertex.Position = position;
 			}
 
 			// Getting UV information
-			if (uvIndex - 1 < temp_uvs.size()) {
-				glm::vec2 uv = temp_uvs[uvIndex - 1];
+			if (uvIndex - 1 < uvs.size()) {
+				glm::vec2 uv = uvs[uvIndex - 1];
 				vertex.UVs = uv;
 			}
 			else {
@@ -121,8 +264,8 @@ OBJLoader::OBJLoader(const std::filesystem::path& modelFilename)
 			}
 
 			// Getting Normals
-			if (normalIndex - 1 < temp_normals.size()) {
-				glm::vec3 normal = temp_normals[normalIndex - 1];
+			if (normalIndex - 1 < normals.size()) {
+				glm::vec3 normal = normals[normalIndex - 1];
 				vertex.Normal = normal;
 			}
 			else {
@@ -130,32 +273,39 @@ OBJLoader::OBJLoader(const std::filesystem::path& modelFilename)
 			}
 
 			vertexes.push_back(vertex);
-			indices.push_back(u);
 		}
 
-		auto instance = Mesh(GL_TRIANGLES, vertexes, indices, 0);
+		Logger::debug("Welded " + std::to_string(mesh.corners.size()) + " corners into " + std::to_string(vertexes.size()) + " vertices");
+
+		MeshData instance;
+		instance.bounds = MeshData::calculateBounds(vertexes);
+		instance.vertices = std::move(vertexes);
+		instance.indices = std::move(indices);
 		instance.material = mesh.material;
-		submeshes.push_back(instance);
+
+		if (settings.optimize) MeshOptimizer::optimize(instance);
+		if (settings.meshlets) MeshletBuilder::build(instance);
+		if (settings.lods) MeshSimplifier::generateLods(instance);
+
+		submeshes.push_back(std::move(instance));
 	}
 }
 
 /**
  * @brief Parses vertex data from the input and stores it as glm::vec3 objects in the output vector.
  *
- * This function parses vertex data from the input vector of strings and stores it as glm::vec3 objects in the output vector. Each string in the input vector represents a vertex in the format "x y z", where x, y, and z are floating-point values representing the x, y, and z coordinates of the vertex.
+ * This function parses vertex data from the rest of a "v" line and stores it as glm::vec3 object in the output vector. The line holds the vertex in the format "x y z", where x, y, and z are floating-point values representing the x, y, and z coordinates of the vertex.
  *
- * @param input A vector of strings representing the vertex data. Each string should contain three floating-point values separated by whitespace, representing the x, y, and z coordinates of the vertex.
+ * @param input View of the line after the "v" header. It should contain three floating-point values separated by whitespace, representing the x, y, and z coordinates of the vertex.
  * @param output An output vector to store the parsed vertex data as glm::vec3 objects.
  */
-void OBJLoader::Parse::vertex(std::vector<std::string> input, std::vector<glm::vec3>& output)
+void OBJLoader::Parse::vertex(std::string_view input, std::vector<glm::vec3>& output)
 {
-	glm::vec3 vertex;
+	glm::vec3 vertex{ 0.0f };
 
-	// This could throw errors if not float
-	// Try-catch would be a good idea.
-	vertex.x = std::stof(input[0]);
-	vertex.y = std::stof(input[1]);
-	vertex.z = std::stof(input[2]);
+	readFloat(input, vertex.x);
+	readFloat(input, vertex.y);
+	readFloat(input, vertex.z);
 
 	output.push_back(vertex);
 }
@@ -163,18 +313,17 @@ void OBJLoader::Parse::vertex(std::vector<std::string> input, std::vector<glm::v
 /**
  * @brief Parses texture coordinate (UV) data from the input and stores it as glm::vec2 objects in the output vector.
  *
- * This function parses texture coordinate (UV) data from the input vector of strings and stores it as glm::vec2 objects in the output vector. Each string in the input vector represents a texture coordinate in the format "u v", where u and v are floating-point values representing the horizontal and vertical components of the texture coordinate (UV).
+ * This function parses texture coordinate (UV) data from the rest of a "vt" line and stores it as glm::vec2 object in the output vector. The line holds the texture coordinate in the format "u v", where u and v are floating-point values representing the horizontal and vertical components of the texture coordinate (UV).
  *
- * @param input A vector of strings representing the texture coordinate (UV) data. Each string should contain two floating-point values separated by whitespace, representing the horizontal and vertical components of the texture coordinate (UV).
+ * @param input View of the line after the "vt" header. It should contain two floating-point values separated by whitespace, representing the horizontal and vertical components of the texture coordinate (UV).
  * @param output An output vector to store the parsed texture coordinate (UV) data as glm::vec2 objects.
  */
-void OBJLoader::Parse::uv(std::vector<std::string> input, std::vector<glm::vec2>& output)
+void OBJLoader::Parse::uv(std::string_view input, std::vector<glm::vec2>& output)
 {
-	glm::vec2 uv;
+	glm::vec2 uv{ 0.0f };
 
-	// Again, try catch would be nice
-	uv.y = std::stof(input[0]);
-	uv.x = std::stof(input[1]);
+	readFloat(input, uv.y);
+	readFloat(input, uv.x);
 
 	output.push_back(uv);
 }
@@ -182,18 +331,18 @@ void OBJLoader::Parse::uv(std::vector<std::string> input, std::vector<glm::vec2>
 /**
  * @brief Parses normal data from the input and stores it as glm::vec3 objects in the output vector.
  *
- * This function parses normal data from the input vector of strings and stores it as glm::vec3 objects in the output vector. Each string in the input vector represents a normal in the format "x y z", where x, y, and z are floating-point values representing the components of the normal.
+ * This function parses normal data from the rest of a "vn" line and stores it as glm::vec3 object in the output vector. The line holds the normal in the format "x y z", where x, y, and z are floating-point values representing the components of the normal.
  *
- * @param input A vector of strings representing the normal data. Each string should contain three floating-point values separated by whitespace, representing the x, y, and z components of the normal.
+ * @param input View of the line after the "vn" header. It should contain three floating-point values separated by whitespace, representing the x, y, and z components of the normal.
  * @param output An output vector to store the parsed normal data as glm::vec3 objects.
  */
-void OBJLoader::Parse::normal(std::vector<std::string> input, std::vector<glm::vec3>& output)
+void OBJLoader::Parse::normal(std::string_view input, std::vector<glm::vec3>& output)
 {
-	glm::vec3 normal;
+	glm::vec3 normal{ 0.0f };
 
-	normal.x = std::stof(input[0]);
-	normal.y = std::stof(input[1]);
-	normal.z = std::stof(input[2]);
+	readFloat(input, normal.x);
+	readFloat(input, normal.y);
+	readFloat(input, normal.z);
 
 	output.push_back(normal);
 }
@@ -201,122 +350,93 @@ void OBJLoader::Parse::normal(std::vector<std::string> input, std::vector<glm::v
 /**
  * @brief Parses a face definition from the input data and extracts vertex indices, texture coordinate indices, and normal indices.
  *
- * This function parses a face definition represented by a vector of strings, extracts the vertex indices, texture coordinate indices, and normal indices, and stores them in separate vectors. Each string in the input vector represents a vertex, texture coordinate, and normal triplet in the format "vertex_index/texture_index/normal_index". In some cases, the triplet does not have to be complete nor be triplet at all. Allowed formats also include, but are not limited to: vertex_index, vertex_index//norma_index, etc...
+ * This function parses a face definition from the rest of an "f" line, extracts the vertex indices, texture coordinate indices, and normal indices, and stores them as one (vertex, texture coordinate, normal) triple per triangle corner. Each whitespace delimited token represents a vertex, texture coordinate, and normal triplet in the format "vertex_index/texture_index/normal_index". In some cases, the triplet does not have to be complete nor be triplet at all. Allowed formats also include, but are not limited to: vertex_index, vertex_index//norma_index, etc...
+ * Missing indices are stored as 0, relative (negative) indices are stored as they are. Faces with more than three vertices are triangulated as a fan around the first vertex.
  *
- * @param input A vector of strings representing the face data. Each string should contain vertex, texture coordinate, and normal indices separated by slashes (/).
- * @param vertices_i An output vector to store the parsed vertex indices.
- * @param uvs_i An output vector to store the parsed texture coordinate indices.
- * @param normals_i An output vector to store the parsed normal indices.
+ * @param input View of the line after the "f" header. Each token should contain vertex, texture coordinate, and normal indices separated by slashes (/).
+ * @param output An output vector to store the (vertex, texture coordinate, normal) indices of every triangle corner.
  */
-void OBJLoader::Parse::face(std::vector<std::string> input, std::vector<unsigned int>& vertices_i, std::vector<unsigned int>& uvs_i, std::vector<unsigned int>& normals_i)
+void OBJLoader::Parse::face(std::string_view input, std::vector<glm::ivec3>& output)
 {
-	int vertexCount = input.size();
-	int vertexIndex[4], uvIndex[4], normalIndex[4];
+	glm::ivec3 first, previous, corner;
+	int vertexCount = 0;
 
 	// Iterate over every vertex of an face
-	for (int i = 0; i < vertexCount; ++i) {
-		std::vector<std::string> values = split(input[i], '/');
+	std::string_view token;
+	while (!(token = nextToken(input)).empty()) {
+		corner = glm::ivec3(0);
 
 		// For each vertex/uv/normal in face, parse 
-		for (int i = 0; i < input.size(); ++i) {
-			auto token = input[i];
-			auto values = split(token, '/');
-
-			for (int j = 0; j < values.size(); ++j) {
-				int number;
-				std::istringstream iss(values[j]);
-
-				// String to integer conversion was successfull
-				if (iss >> number) {
-					// This could be done in a better way.
-					if (j == 0) vertexIndex[i] = number;
-					if (j == 1) uvIndex[i] = number;
-					if (j == 2) normalIndex[i] = number;
-				}
-			}
-		}
-	}
+		for (int j = 0; j < 3; ++j) {
+			parseNumber(token, corner[j]);
 
-	// Handle triangular face
-	if (vertexCount == 3) {
-		for (int i = 0; i < 3; ++i) {
-			vertices_i.push_back(vertexIndex[i]);
-			uvs_i.push_back(uvIndex[i]);
-			normals_i.push_back(normalIndex[i]);
+			if (token.empty() || token.front() != '/') break;
+			token.remove_prefix(1);
 		}
-	}
-	// Handle quad face
-	// Convert it into two triangles
-	else if (vertexCount == 4) {
-		for (int i = 0; i < 3; ++i) {
-			vertices_i.push_back(vertexIndex[i]);
-			uvs_i.push_back(uvIndex[i]);
-			normals_i.push_back(normalIndex[i]);
-		}
-		for (int i = 2; i < 5; ++i) {
-			vertices_i.push_back(vertexIndex[i % 4]);
-			uvs_i.push_back(uvIndex[i % 4]);
-			normals_i.push_back(normalIndex[i % 4]);
+
+		if (vertexCount == 0) first = corner;
+		if (vertexCount >= 2) {
+			output.push_back(first);
+			output.push_back(previous);
+			output.push_back(corner);
 		}
+
+		previous = corner;
+		vertexCount++;
 	}
-	else {
-		printf("Error: Face format not supported.\n");
-		return;
+
+	if (vertexCount < 3) {
+		Logger::warning("Face with less than three vertices skipped.");
 	}
 }
 
 /**
  * @brief Parses material data from the input and appends it to the specified vector of Material objects.
  *
- * This function parses material data from the input vector of strings, representing an path to a MTL file, and appends the parsed materials to the specified vector of Material objects.
- * The input vector are tokens of path to an MTL file, potentionally delimited by whitespace.
- * This function takes only a first element of the input vector into account.
- * The function iterates over each line of the MTL file, parsing the material properties and creating Material objects accordingly.
+ * This function parses material data from the rest of an "mtllib" line, representing an path to a MTL file, and appends the parsed materials to the specified vector of Material objects.
+ * This function takes only a first token of the input into account.
+ * The function maps the MTL file and iterates over each of its lines, parsing the material properties and creating Material objects accordingly.
  * The parsed materials are appended to the output vector.
  *
- * @param input A vector of strings representing path(s) to an MTL file.
+ * @param input View of the line after the "mtllib" header, holding path(s) to an MTL file.
  * @param path The path to the directory containing the MTL file.
  * @param output A reference to the vector of Material objects to which the parsed materials will be appended.
  */
-void OBJLoader::Parse::MTL(std::vector<std::string> input, std::string path, std::unordered_map<std::string, Material>& materials)
+void OBJLoader::Parse::MTL(std::string_view input, const std::filesystem::path& path, std::unordered_map<std::string, Material>& materials)
 {
-	if (input.empty()) {
+	std::string_view name = nextToken(input);
+	if (name.empty()) {
 		Logger::error("Object has 'mtllib' line defined, but no path to MTL file was found.");
 		return;
 	}
 
-	std::string filename = path + "/" + input.front();
-	std::ifstream file(filename);
+	std::filesystem::path filename = path / name;
+	MappedFile file(filename);
 
-	if (!file.is_open()) {
-		Logger::error("Unable to open file " + filename);
+	if (!file.isOpen()) {
+		Logger::error("Unable to open file " + filename.string());
 		return;
 	}
 
 	Material currentMaterial;
-	std::string line;
-	while (std::getline(file, line)) {
-		std::vector<std::string> tokens = split(line, ' ');
-
-		// If the line is empty for some reason, we skip it.
-		// This should not happen, but better be safe than sorry.
-		if (tokens.empty()) continue;
-
+	std::string_view text = file.view();
+	while (!text.empty()) {
+		std::string_view line = nextLine(text);
 		// Get the line header
-		std::string header = tokens.front();
-		tokens.erase(tokens.begin());
+		std::string_view header = nextToken(line);
 
-		if (header == "newmtl") {
+		if (header.empty() || header.front() == '#') continue;
+		else if (header == "newmtl") {
 			if (!currentMaterial.name.empty()) materials[currentMaterial.name] = currentMaterial;
 			currentMaterial = Material();
-			currentMaterial.name = tokens[0];
+			currentMaterial.name = std::string(nextToken(line));
 		}
-		else if (header == "Ka") OBJLoader::Parse::ambient(tokens, currentMaterial);
-		else if (header == "Kd") OBJLoader::Parse::diffuse(tokens, currentMaterial);
-		else if (header == "Ks") OBJLoader::Parse::specular(tokens, currentMaterial);
-		else if (header == "d") OBJLoader::Parse::dissolve(tokens, currentMaterial);
-		else if (header == "Ns") currentMaterial.shininess = std::stof(tokens[0]);
-		else if (header == "map_Kd") OBJLoader::Parse::texture(tokens, currentMaterial);
+		else if (header == "Ka") OBJLoader::Parse::ambient(line, currentMaterial);
+		else if (header == "Kd") OBJLoader::Parse::diffuse(line, currentMaterial);
+		else if (header == "Ks") OBJLoader::Parse::specular(line, currentMaterial);
+		else if (header == "d") OBJLoader::Parse::dissolve(line, currentMaterial);
+		else if (header == "Ns") readFloat(line, currentMaterial.shininess);
+		else if (header == "map_Kd") OBJLoader::Parse::texture(line, currentMaterial);
 	}
 
 	if (!currentMaterial.name.empty()) materials[currentMaterial.name] = currentMaterial;
@@ -325,126 +445,100 @@ void OBJLoader::Parse::MTL(std::vector<std::string> input, std::string path, std
 /**
  * @brief Parses ambient color data from the input and assigns it to the specified Material object.
  *
- * This function parses ambient color data from the input vector of strings and assigns it to the specified Material object.
- * The input vector should contain three strings representing the red, green, and blue components of the ambient color, respectively.
+ * This function parses ambient color data from the rest of a "Ka" line and assigns it to the specified Material object.
+ * The line should contain three values representing the red, green, and blue components of the ambient color, respectively.
  * The ambient color components are converted to floating-point values and assigned to the corresponding elements of the Material's ambient vector.
  *
- * @param input A vector of strings representing the ambient color data. The first string should represent the red component, the second string the green component, and the third string the blue component.
+ * @param input View of the line after the "Ka" header. The first value should represent the red component, the second value the green component, and the third value the blue component.
  * @param output A reference to the Material object to which the parsed ambient color data will be assigned.
  */
-void OBJLoader::Parse::ambient(std::vector<std::string> input, Material& output)
+void OBJLoader::Parse::ambient(std::string_view input, Material& output)
 {
-	output.ambient[0] = std::stof(input[0]);
-	output.ambient[1] = std::stof(input[1]);
-	output.ambient[2] = std::stof(input[2]);
+	readFloat(input, output.ambient[0]);
+	readFloat(input, output.ambient[1]);
+	readFloat(input, output.ambient[2]);
 }
 
 /**
  * @brief Parses diffuse color data from the input and assigns it to the specified Material object.
  *
- * This function parses diffuse color data from the input vector of strings and assigns it to the specified Material object.
- * The input vector should contain three strings representing the red, green, and blue components of the diffuse color, respectively.
+ * This function parses diffuse color data from the rest of a "Kd" line and assigns it to the specified Material object.
+ * The line should contain three values representing the red, green, and blue components of the diffuse color, respectively.
  * The diffuse color components are converted to floating-point values and assigned to the corresponding elements of the Material's diffuse vector.
  *
- * @param input A vector of strings representing the diffuse color data. The first string should represent the red component, the second string the green component, and the third string the blue component.
+ * @param input View of the line after the "Kd" header. The first value should represent the red component, the second value the green component, and the third value the blue component.
  * @param output A reference to the Material object to which the parsed diffuse color data will be assigned.
  */
-void OBJLoader::Parse::diffuse(std::vector<std::string> input, Material& output)
+void OBJLoader::Parse::diffuse(std::string_view input, Material& output)
 {
-	output.diffuse[0] = std::stof(input[0]);
-	output.diffuse[1] = std::stof(input[1]);
-	output.diffuse[2] = std::stof(input[2]);
+	readFloat(input, output.diffuse[0]);
+	readFloat(input, output.diffuse[1]);
+	readFloat(input, output.diffuse[2]);
 }
 
 /**
  * @brief Parses specular color data from the input and assigns it to the specified Material object.
  *
- * This function parses specular color data from the input vector of strings and assigns it to the specified Material object.
- * The input vector should contain three strings representing the red, green, and blue components of the specular color, respectively.
+ * This function parses specular color data from the rest of a "Ks" line and assigns it to the specified Material object.
+ * The line should contain three values representing the red, green, and blue components of the specular color, respectively.
  * The specular color components are converted to floating-point values and assigned to the corresponding elements of the Material's specular vector.
  *
- * @param input A vector of strings representing the specular color data. The first string should represent the red component, the second string the green component, and the third string the blue component.
+ * @param input View of the line after the "Ks" header. The first value should represent the red component, the second value the green component, and the third value the blue component.
  * @param output A reference to the Material object to which the parsed specular color data will be assigned.
  */
-void OBJLoader::Parse::specular(std::vector<std::string> input, Material& output)
+void OBJLoader::Parse::specular(std::string_view input, Material& output)
 {
-	output.specular[0] = std::stof(input[0]);
-	output.specular[1] = std::stof(input[1]);
-	output.specular[2] = std::stof(input[2]);
+	readFloat(input, output.specular[0]);
+	readFloat(input, output.specular[1]);
+	readFloat(input, output.specular[2]);
 }
 
 /**
  * @brief Parses dissolve data from the input and assigns it to the specified Material object.
  *
- * This function parses dissolve data from the input vector of strings and assigns it to the specified Material object.
+ * This function parses dissolve data from the rest of a "d" line and assigns it to the specified Material object.
  * MTL files represent transparency with dissolve attribute, which ranges from 0 to 1
  * When dissolve is 1, the material is completely opaque.
  * When dissolve is 0, the material is completely transparent.
  * 
- * The input vector should contain one string representing transparency of the object.
+ * The line should contain one value representing transparency of the object.
  * The parsed dissolve is converted to floating-point value and assigned to the Material.
  *
- * @param input A vector of strings representing the transparency.
+ * @param input View of the line after the "d" header.
  * @param output A reference to the Material object to which the parsed transparency will be assigned.
  */
-void OBJLoader::Parse::dissolve(std::vector<std::string> input, Material& output)
+void OBJLoader::Parse::dissolve(std::string_view input, Material& output)
 {
-	output.transparency = std::stof(input[0]);
+	readFloat(input, output.transparency);
 }
 
-void OBJLoader::Parse::texture(std::vector<std::string> input, Material& output)
+/**
+ * @brief Parses texture map data from the input and assigns it to the specified Material object.
+ *
+ * This function parses the rest of a "map_Kd" line. Options come first, the path to the image is the last token of the line.
+ * Only the "-s" (scale) option is taken into account. The image itself is not loaded here, only its path is stored,
+ * so materials stay plain data until the model uploads them.
+ *
+ * @param input View of the line after the "map_Kd" header.
+ * @param output A reference to the Material object to which the parsed texture will be assigned.
+ */
+void OBJLoader::Parse::texture(std::string_view input, Material& output)
 {
-	GLuint textureID;
     auto texture = Texture{};
-    auto path = input.back();
-
-    // 1. Load the image using OpenCV
-    cv::Mat img = cv::imread(path, cv::IMREAD_UNCHANGED);
 
-    if (img.empty()) {
-        Logger::error("Failed to load texture at path: " + path);
-        return;
-    }
-
-    // 2. Handle Color Space Conversion
-    // OpenGL needs RGB(A), but OpenCV loads BGR(A)
-    GLenum format;
-    if (img.channels() == 4) {
-        cv::cvtColor(img, img, cv::COLOR_BGRA2RGBA);
-        format = GL_RGBA;
-    } else if (img.channels() == 3) {
-        cv::cvtColor(img, img, cv::COLOR_BGR2RGB);
-        format = GL_RGB;
-    } else {
-        format = GL_RED; // Grayscale
-    }
-
-	for (size_t i = 0; i < input.size(); ++i) {
-        if (input[i] == "-s" && i + 2 < input.size()) {
-            texture.scale.x = std::stof(input[i + 1]);
-            texture.scale.y = std::stof(input[i + 2]);
+    std::string_view token;
+    while (!(token = nextToken(input)).empty()) {
+        if (token == "-s") {
+            readFloat(input, texture.scale.x);
+            readFloat(input, texture.scale.y);
         }
+        else texture.path = token;
     }
 
-    // 3. OpenGL Setup
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
-
-    // Note: OpenCV stores pixels top-to-bottom. 
-    // If your textures look upside down, use cv::flip(img, img, 0);
-    cv::flip(img, img, 0); 
-
-    glTexImage2D(GL_TEXTURE_2D, 0, format, img.cols, img.rows, 0, format, GL_UNSIGNED_BYTE, img.data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    // Wrapping/Filtering (Same as your current code)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    if (texture.path.empty()) {
+        Logger::error("Material has 'map_Kd' line defined, but no path to the image was found.");
+        return;
+    }
 
-    texture.id = textureID;
     output.texture = texture;
-    
-    Logger::info("Created OpenCV Texture ID: " + std::to_string(textureID));
-}
\ No newline at end of file
+}
@@ -1,37 +1,63 @@
 #pragma once
+#include <cstdint>
+#include <string_view>
 #include <unordered_map>
 #include "mesh.hpp"
 #include "material.hpp"
 
+struct ImportSettings {
+    // Split big files at line boundaries and parse the pieces on all cores.
+    // Files smaller than the threshold are always parsed on the calling thread.
+    bool parallel = true;
+    size_t parallelThreshold = 1 << 20;
+
+    // Reorder triangles and vertices for the post-transform cache, overdraw and vertex fetch.
+    bool optimize = true;
+
+    // Split meshes into clusters of triangles the renderer culls one by one, see MeshletBuilder.
+    bool meshlets = true;
+
+    // Append coarser levels of detail to every mesh, see MeshSimplifier.
+    bool lods = true;
+
+    // GPU vertex format of the meshes, applied at upload so it does not affect the caches
+    VertexFormat vertexFormat = VertexFormat::Quantized;
+
+    // Options changing the imported data, caches built with other ones are not valid
+    uint32_t signature() const { return (optimize ? 1u : 0u) | (meshlets ? 2u : 0u) | (lods ? 4u : 0u); }
+};
+
 class OBJLoader
 {
 public:
-    OBJLoader(const std::filesystem::path& filename);
+    OBJLoader(const std::filesystem::path& filename, const ImportSettings& settings = ImportSettings{});
 
     std::vector< glm::vec3 > vertices;
     std::vector< glm::vec2 > uvs;
     std::vector< glm::vec3 > normals;
 
-    std::vector<Mesh> submeshes;
+    std::vector<MeshData> submeshes;
+    // MTL files the model depends on
+    std::vector<std::filesystem::path> libraries;
 
+    // All parsers take the rest of the line after its header
     class Parse {
     public:
         // OBJ file
-        static void vertex(std::vector<std::string> input, std::vector<glm::vec3>& output);
-        static void uv(std::vector<std::string> input, std::vector<glm::vec2>& output);
-        static void normal(std::vector<std::string> input, std::vector<glm::vec3>& output);
-        static void face(std::vector<std::string> input, std::vector<unsigned int>& vertices_i, std::vector<unsigned int>& uvs_i, std::vector<unsigned int>& normals_i);
+        static void vertex(std::string_view input, std::vector<glm::vec3>& output);
+        static void uv(std::string_view input, std::vector<glm::vec2>& output);
+        static void normal(std::string_view input, std::vector<glm::vec3>& output);
+        static void face(std::string_view input, std::vector<glm::ivec3>& output);
 
         // MTL file
-        static void MTL(std::vector<std::string> input, std::string modelFilename, std::unordered_map<std::string, Material>& materials);
-        static void ambient(std::vector<std::string> input, Material& output);
-        static void diffuse(std::vector<std::string> input, Material& output);
-        static void specular(std::vector<std::string> input, Material& output);
-        static void dissolve(std::vector<std::string> input, Material& output);
-        static void texture(std::vector<std::string> input, Material& output);
+        static void MTL(std::string_view input, const std::filesystem::path& path, std::unordered_map<std::string, Material>& materials);
+        static void ambient(std::string_view input, Material& output);
+        static void diffuse(std::string_view input, Material& output);
+        static void specular(std::string_view input, Material& output);
+        static void dissolve(std::string_view input, Material& output);
+        static void texture(std::string_view input, Material& output);
     };
 
 private:
     std::unordered_map<std::string, Material> materials;
 };
-
@@ -0,0 +1,210 @@
+#include "occlusion_culler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define OCCLUSION_CULLER_SSE
+#include <xmmintrin.h>
+#endif
+
+// Clip space w of the nearest point that is still projected, the camera near plane is at 0.1
+static const float NEAR_W = 0.05f;
+
+// Largest screen rectangle of a box tested at one level, in texels per axis
+static const int MAX_TEST_TEXELS = 4;
+
+OcclusionCuller::OcclusionCuller(int width, int height)
+{
+    width = std::max((width + 3) & ~3, 4);
+    height = std::max(height, 1);
+
+    for (;;) {
+        levels.push_back(Level{ width, height, std::vector<float>(size_t(width) * height, 1.0f) });
+        if (width == 1 && height == 1) break;
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+    }
+}
+
+void OcclusionCuller::clear(const glm::mat4& viewProjection)
+{
+    this->viewProjection = viewProjection;
+    std::fill(levels.front().depth.begin(), levels.front().depth.end(), 1.0f);
+}
+
+void OcclusionCuller::rasterize(const std::vector<Vertex>& vertices, const GLuint* indices, size_t indexCount, const glm::mat4& transform)
+{
+    const glm::mat4 clip = viewProjection * transform;
+    const float width = static_cast<float>(getWidth());
+    const float height = static_cast<float>(getHeight());
+
+    // Every vertex once, triangles share most of them
+    screen.resize(vertices.size());
+    for (size_t v = 0; v < vertices.size(); ++v) {
+        glm::vec4 position = clip * glm::vec4(vertices[v].Position, 1.0f);
+        if (position.w < NEAR_W) {
+            screen[v] = glm::vec4(0.0f, 0.0f, 0.0f, -1.0f);
+            continue;
+        }
+
+        glm::vec3 ndc = glm::vec3(position) / position.w;
+        screen[v] = glm::vec4((ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height, ndc.z * 0.5f + 0.5f, position.w);
+    }
+
+    for (size_t i = 0; i + 2 < indexCount; i += 3) {
+        const glm::vec4& a = screen[indices[i]];
+        const glm::vec4& b = screen[indices[i + 1]];
+        const glm::vec4& c = screen[indices[i + 2]];
+        if (a.w < 0.0f || b.w < 0.0f || c.w < 0.0f) continue;
+
+        rasterizeTriangle(glm::vec3(a), glm::vec3(b), glm::vec3(c));
+    }
+}
+
+void OcclusionCuller::rasterizeTriangle(glm::vec3 a, glm::vec3 b, glm::vec3 c)
+{
+    // Both windings are drawn, a back face is just as solid. Counter-clockwise from here on.
+    float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+    if (area < 0.0f) {
+        std::swap(b, c);
+        area = -area;
+    }
+    if (area < 1e-6f) return;
+
+    Level& level = levels.front();
+    int minX = std::max(static_cast<int>(std::floor(std::min({ a.x, b.x, c.x }))), 0);
+    int maxX = std::min(static_cast<int>(std::ceil(std::max({ a.x, b.x, c.x }))), level.width - 1);
+    int minY = std::max(static_cast<int>(std::floor(std::min({ a.y, b.y, c.y }))), 0);
+    int maxY = std::min(static_cast<int>(std::ceil(std::max({ a.y, b.y, c.y }))), level.height - 1);
+    if (minX > maxX || minY > maxY) return;
+
+    // Edge functions, positive inside, and their steps per pixel
+    struct Edge {
+        float stepX, stepY, value;
+    };
+    auto edge = [](const glm::vec3& from, const glm::vec3& to, float x, float y) {
+        return Edge{ -(to.y - from.y), to.x - from.x, (to.x - from.x) * (y - from.y) - (to.y - from.y) * (x - from.x) };
+    };
+
+    // Sampled at pixel centers, the row starts on a multiple of 4
+    minX &= ~3;
+    const float startX = minX + 0.5f, startY = minY + 0.5f;
+    Edge e0 = edge(b, c, startX, startY);
+    Edge e1 = edge(c, a, startX, startY);
+    Edge e2 = edge(a, b, startX, startY);
+
+    // Depth is linear in screen space, z = a.z + e1 * dzB + e2 * dzC
+    const float dzB = (b.z - a.z) / area, dzC = (c.z - a.z) / area;
+
+#ifdef OCCLUSION_CULLER_SSE
+    const __m128 lanes = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 step0 = _mm_set1_ps(4.0f * e0.stepX), step1 = _mm_set1_ps(4.0f * e1.stepX), step2 = _mm_set1_ps(4.0f * e2.stepX);
+    const __m128 depthB = _mm_set1_ps(dzB), depthC = _mm_set1_ps(dzC), depthA = _mm_set1_ps(a.z);
+
+    for (int y = minY; y <= maxY; ++y) {
+        __m128 w0 = _mm_add_ps(_mm_set1_ps(e0.value), _mm_mul_ps(lanes, _mm_set1_ps(e0.stepX)));
+        __m128 w1 = _mm_add_ps(_mm_set1_ps(e1.value), _mm_mul_ps(lanes, _mm_set1_ps(e1.stepX)));
+        __m128 w2 = _mm_add_ps(_mm_set1_ps(e2.value), _mm_mul_ps(lanes, _mm_set1_ps(e2.stepX)));
+        float* row = level.depth.data() + size_t(y) * level.width;
+
+        for (int x = minX; x <= maxX; x += 4) {
+            __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(w0, zero), _mm_cmpge_ps(w1, zero)), _mm_cmpge_ps(w2, zero));
+
+            if (_mm_movemask_ps(inside)) {
+                __m128 depth = _mm_add_ps(depthA, _mm_add_ps(_mm_mul_ps(w1, depthB), _mm_mul_ps(w2, depthC)));
+                __m128 current = _mm_loadu_ps(row + x);
+                __m128 nearest = _mm_min_ps(current, depth);
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+            }
+
+            w0 = _mm_add_ps(w0, step0);
+            w1 = _mm_add_ps(w1, step1);
+            w2 = _mm_add_ps(w2, step2);
+        }
+
+        e0.value += e0.stepY;
+        e1.value += e1.stepY;
+        e2.value += e2.stepY;
+    }
+#else
+    for (int y = minY; y <= maxY; ++y) {
+        float w0 = e0.value, w1 = e1.value, w2 = e2.value;
+        float* row = level.depth.data() + size_t(y) * level.width;
+
+        for (int x = minX; x <= maxX; ++x) {
+            if (w0 >= 0.0f && w1 >= 0.0f && w2 >= 0.0f) {
+                row[x] = std::min(row[x], a.z + w1 * dzB + w2 * dzC);
+            }
+
+            w0 += e0.stepX;
+            w1 += e1.stepX;
+            w2 += e2.stepX;
+        }
+
+        e0.value += e0.stepY;
+        e1.value += e1.stepY;
+        e2.value += e2.stepY;
+    }
+#endif
+}
+
+void OcclusionCuller::finish()
+{
+    // Every texel keeps the farthest depth of the pixels below it
+    for (size_t l = 1; l < levels.size(); ++l) {
+        const Level& fine = levels[l - 1];
+        Level& coarse = levels[l];
+
+        for (int y = 0; y < coarse.height; ++y) {
+            int y0 = 2 * y, y1 = std::min(2 * y + 1, fine.height - 1);
+            for (int x = 0; x < coarse.width; ++x) {
+                int x0 = 2 * x, x1 = std::min(2 * x + 1, fine.width - 1);
+                coarse.depth[size_t(y) * coarse.width + x] = std::max(
+                    std::max(fine.depth[size_t(y0) * fine.width + x0], fine.depth[size_t(y0) * fine.width + x1]),
+                    std::max(fine.depth[size_t(y1) * fine.width + x0], fine.depth[size_t(y1) * fine.width + x1]));
+            }
+        }
+    }
+}
+
+bool OcclusionCuller::isOccluded(const AABB& box) const
+{
+    glm::vec2 low(std::numeric_limits<float>::max()), high(std::numeric_limits<float>::lowest());
+    float nearest = std::numeric_limits<float>::max();
+
+    for (int corner = 0; corner < 8; ++corner) {
+        glm::vec3 point((corner & 1) ? box.max.x : box.min.x, (corner & 2) ? box.max.y : box.min.y, (corner & 4) ? box.max.z : box.min.z);
+        glm::vec4 position = viewProjection * glm::vec4(point, 1.0f);
+
+        // Reaching behind the camera, the rectangle would not hold
+        if (position.w < NEAR_W) return false;
+
+        glm::vec3 ndc = glm::vec3(position) / position.w;
+        low = glm::min(low, glm::vec2(ndc.x, ndc.y));
+        high = glm::max(high, glm::vec2(ndc.x, ndc.y));
+        nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+    }
+
+    // Outside the screen is for the frustum culling to decide
+    if (high.x < -1.0f || high.y < -1.0f || low.x > 1.0f || low.y > 1.0f) return false;
+
+    const Level& base = levels.front();
+    int x0 = std::clamp(static_cast<int>((low.x * 0.5f + 0.5f) * base.width), 0, base.width - 1);
+    int x1 = std::clamp(static_cast<int>((high.x * 0.5f + 0.5f) * base.width), 0, base.width - 1);
+    int y0 = std::clamp(static_cast<int>((low.y * 0.5f + 0.5f) * base.height), 0, base.height - 1);
+    int y1 = std::clamp(static_cast<int>((high.y * 0.5f + 0.5f) * base.height), 0, base.height - 1);
+
+    size_t l = 0;
+    while (l + 1 < levels.size() && ((x1 >> l) - (x0 >> l) >= MAX_TEST_TEXELS || (y1 >> l) - (y0 >> l) >= MAX_TEST_TEXELS)) l++;
+
+    const Level& level = levels[l];
+    for (int y = y0 >> l; y <= (y1 >> l); ++y) {
+        for (int x = x0 >> l; x <= (x1 >> l); ++x) {
+            if (level.depth[size_t(y) * level.width + x] >= nearest) return false;
+        }
+    }
+    return true;
+}
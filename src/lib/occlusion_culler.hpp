@@ -0,0 +1,56 @@
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <vector>
+
+#include "vertex.hpp"
+#include "physics.hpp"
+
+/*
+    Software occlusion culling on a small CPU depth buffer, no GPU involved.
+    - occluders are rasterized four pixels at a time with SSE where it is available,
+      triangles reaching behind the near plane are left out, so nothing is hidden wrongly
+    - the depth is reduced into a max-depth hierarchy, a box is tested against the level
+      where its screen rectangle covers at most 4x4 texels
+    - depth is the NDC depth mapped to [0, 1], rows go bottom up like OpenGL
+*/
+class OcclusionCuller
+{
+public:
+    static const int WIDTH = 256;
+    static const int HEIGHT = 144;
+
+    // The width is rounded up to a multiple of 4
+    explicit OcclusionCuller(int width = WIDTH, int height = HEIGHT);
+
+    // Starts a frame seen through viewProjection, with nothing in the way
+    void clear(const glm::mat4& viewProjection);
+    // Draws indexed triangles given in the local space of transform into the depth buffer
+    void rasterize(const std::vector<Vertex>& vertices, const GLuint* indices, size_t indexCount, const glm::mat4& transform);
+    // Builds the hierarchy out of the depth buffer, has to follow the last rasterize
+    void finish();
+
+    // True when the world space box lies behind the occluders everywhere on screen
+    bool isOccluded(const AABB& box) const;
+
+    int getWidth() const { return levels.front().width; }
+    int getHeight() const { return levels.front().height; }
+    const std::vector<float>& getDepth() const { return levels.front().depth; }
+
+private:
+    struct Level {
+        int width;
+        int height;
+        std::vector<float> depth;
+    };
+
+    // The first level is the depth buffer itself, every next one half its size
+    std::vector<Level> levels;
+    glm::mat4 viewProjection{ 1.0f };
+
+    // Screen positions of the transformed vertices, w below zero marks ones behind the camera
+    std::vector<glm::vec4> screen;
+
+    void rasterizeTriangle(glm::vec3 a, glm::vec3 b, glm::vec3 c);
+};
@@ -1,6 +1,7 @@
 #pragma once
 #include <glm/glm.hpp>
 #include <algorithm>
+#include <array>
 #include <vector>
 
 struct AABB {
@@ -18,4 +19,58 @@ struct AABB {
                (point.y >= min.y && point.y <= max.y) &&
                (point.z >= min.z && point.z <= max.z);
     }
-};
\ No newline at end of file
+
+    // Box around the transformed box (Arvo 1990), every output axis takes
+    // the smaller and the larger product of each matrix element with the input extent
+    AABB transformed(const glm::mat4 &transform) const {
+        glm::vec3 translation(transform[3]);
+        AABB result{ translation, translation };
+
+        for (int column = 0; column < 3; ++column) {
+            for (int row = 0; row < 3; ++row) {
+                float a = transform[column][row] * min[column];
+                float b = transform[column][row] * max[column];
+                result.min[row] += std::min(a, b);
+                result.max[row] += std::max(a, b);
+            }
+        }
+        return result;
+    }
+};
+
+struct Sphere {
+    glm::vec3 center;
+    float radius;
+};
+
+/*
+    View frustum as six planes (left, right, bottom, top, near, far), normals pointing inside.
+    - extracted from a clip matrix, projection * view gives world space planes,
+      projection * view * transform the local space planes of that model
+*/
+struct Frustum {
+    std::array<glm::vec4, 6> planes;
+
+    Frustum() = default;
+
+    explicit Frustum(const glm::mat4 &clip) {
+        glm::vec4 x(clip[0][0], clip[1][0], clip[2][0], clip[3][0]);
+        glm::vec4 y(clip[0][1], clip[1][1], clip[2][1], clip[3][1]);
+        glm::vec4 z(clip[0][2], clip[1][2], clip[2][2], clip[3][2]);
+        glm::vec4 w(clip[0][3], clip[1][3], clip[2][3], clip[3][3]);
+
+        planes = { w + x, w - x, w + y, w - y, w + z, w - z };
+
+        // Unit normals, so the plane equation gives distances
+        for (glm::vec4 &plane : planes) {
+            plane = plane / glm::length(glm::vec3(plane));
+        }
+    }
+
+    bool intersects(const glm::vec3 &center, float radius) const {
+        for (const glm::vec4 &plane : planes) {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) return false;
+        }
+        return true;
+    }
+};
@@ -0,0 +1,146 @@
+#include "program_cache.hpp"
+#include "mapped_file.hpp"
+#include "cache_file.hpp"
+#include "string_utils.hpp"
+#include "logger.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+/*
+    File layout, see cache_file.hpp for the conventions:
+    - FileHeader
+    - driver string, GL_RENDERER and GL_VERSION of the context that linked the program
+    - program binary
+*/
+
+// Bump whenever the layout changes
+static const uint32_t PROGRAM_CACHE_VERSION = 1;
+static const char PROGRAM_CACHE_MAGIC[4] = { 'I', 'C', 'P', 'P' };
+
+struct FileHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceHash;
+    uint32_t binaryFormat;
+    uint32_t binaryLength;
+    uint32_t driverLength;
+    uint32_t padding;
+};
+
+std::filesystem::path ProgramCache::directory = "cache/programs";
+
+bool ProgramCache::isSupported()
+{
+    static const bool supported = [] {
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        if (formats == 0) Logger::info("Driver has no program binary formats, programs are always compiled");
+        return formats > 0;
+    }();
+    return supported;
+}
+
+std::string ProgramCache::driver()
+{
+    auto text = [](GLenum name) {
+        const GLubyte* value = glGetString(name);
+        return value ? std::string(reinterpret_cast<const char*>(value)) : std::string();
+    };
+    return text(GL_RENDERER) + "\n" + text(GL_VERSION);
+}
+
+uint64_t ProgramCache::sourceHash(const std::vector<std::string>& sources)
+{
+    uint64_t hash = 0;
+    for (const std::string& source : sources) hash = hashBytes(source, hash);
+    return hash;
+}
+
+std::filesystem::path ProgramCache::cachePath(uint64_t hash)
+{
+    // The driver is part of the name, switching GPUs keeps the binaries of both
+    char name[64];
+    snprintf(name, sizeof(name), "%016llx-%016llx.progcache", static_cast<unsigned long long>(hash),
+        static_cast<unsigned long long>(hashBytes(driver())));
+    return directory / name;
+}
+
+GLuint ProgramCache::load(const std::vector<std::string>& sources)
+{
+    if (!isSupported()) return 0;
+
+    const uint64_t hash = sourceHash(sources);
+    const std::filesystem::path path = cachePath(hash);
+
+    MappedFile file(path);
+    if (!file.isOpen()) return 0;
+
+    CacheReader reader(file.view());
+
+    FileHeader header;
+    if (!reader.read(header)) return 0;
+    if (std::memcmp(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic)) != 0) return 0;
+    if (header.version != PROGRAM_CACHE_VERSION || header.sourceHash != hash) return 0;
+
+    std::string linkedBy;
+    if (!reader.read(linkedBy, header.driverLength) || linkedBy != driver()) return 0;
+
+    std::vector<char> binary;
+    if (!reader.read(binary, header.binaryLength)) {
+        Logger::warning("Program cache " + path.string() + " is truncated");
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, static_cast<GLenum>(header.binaryFormat), binary.data(), static_cast<GLsizei>(binary.size()));
+
+    // Drivers may still refuse their own binaries, after an update that kept the version string
+    GLint status = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status == GL_FALSE) {
+        Logger::debug("Program cache " + path.string() + " rejected by the driver");
+        glDeleteProgram(program);
+        return 0;
+    }
+
+    return program;
+}
+
+void ProgramCache::prepare(GLuint program)
+{
+    if (isSupported()) glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+void ProgramCache::store(const std::vector<std::string>& sources, GLuint program)
+{
+    if (!isSupported()) return;
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+
+    std::vector<char> binary(static_cast<size_t>(length));
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &format, binary.data());
+    if (written <= 0) return;
+
+    const uint64_t hash = sourceHash(sources);
+    const std::string linkedBy = driver();
+
+    CacheFile::write(cachePath(hash), [&](CacheWriter& writer) {
+        FileHeader header{};
+        std::memcpy(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic));
+        header.version = PROGRAM_CACHE_VERSION;
+        header.sourceHash = hash;
+        header.binaryFormat = format;
+        header.binaryLength = static_cast<uint32_t>(written);
+        header.driverLength = static_cast<uint32_t>(linkedBy.size());
+        writer.write(header);
+
+        writer.write(linkedBy.data(), linkedBy.size());
+        writer.write(binary.data(), static_cast<size_t>(written));
+    });
+}
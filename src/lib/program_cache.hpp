@@ -0,0 +1,33 @@
+#pragma once
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+/*
+    Binary cache of linked programs (glGetProgramBinary), later launches skip compiling and linking.
+    - keyed by the final sources (after the version patch and the defines) together with
+      GL_RENDERER and GL_VERSION, a binary never reaches another GPU or driver
+    - a binary the driver rejects anyway is dropped and the program is built from source again
+*/
+class ProgramCache
+{
+public:
+    static std::filesystem::path directory;
+
+    // Linked program from the cache, 0 if there is none or the driver does not take it
+    static GLuint load(const std::vector<std::string>& sources);
+
+    // Call before glLinkProgram, drivers may keep no binary to retrieve otherwise
+    static void prepare(GLuint program);
+
+    // Writes the binary of the linked program built from the sources
+    static void store(const std::vector<std::string>& sources, GLuint program);
+
+private:
+    // The driver has to support at least one binary format for any of this
+    static bool isSupported();
+    static std::string driver();
+    static uint64_t sourceHash(const std::vector<std::string>& sources);
+    static std::filesystem::path cachePath(uint64_t hash);
+};
@@ -5,6 +5,8 @@
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
+#include <algorithm>
+#include <cstring>
 #include <thread>
 
 Camera *Renderer::camera = nullptr;
@@ -34,6 +36,24 @@ float Renderer::lastX = 0.0f;
 float Renderer::lastY = 0.0f;
 
 RenderQueue Renderer::queue;
+RenderStatistics Renderer::statistics;
+std::unordered_map<GLuint, MaterialUniforms> Renderer::materialUniforms;
+Renderer::DrawState Renderer::state;
+CameraBlock Renderer::frame{};
+Frustum Renderer::frustum{};
+bool Renderer::occlusionCulling = true;
+OcclusionCuller Renderer::occlusion;
+bool Renderer::weightedBlended = false;
+Renderer::TransparencyTargets Renderer::transparency;
+Shader* Renderer::compositeShader = nullptr;
+bool Renderer::depthPrepass = false;
+Shader* Renderer::depthShader = nullptr;
+Uniform<glm::vec3> Renderer::depthPositionOffset;
+Uniform<glm::vec3> Renderer::depthPositionScale;
+GLuint Renderer::cameraBuffer = 0;
+std::vector<glm::mat4> Renderer::instances;
+GLuint Renderer::instanceBuffer = 0;
+size_t Renderer::instanceCapacity = 0;
 
 std::array<int, 2> Renderer::position = {0, 0};
 std::string Renderer::name = "ICP";
@@ -167,6 +187,14 @@ void Renderer::setGlfwFeatures()
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 }
 
+void Renderer::setUniformBuffers()
+{
+    // Bound once for good, every program reads its Camera block from here
+    glCreateBuffers(1, &cameraBuffer);
+    glNamedBufferStorage(cameraBuffer, sizeof(CameraBlock), nullptr, GL_DYNAMIC_STORAGE_BIT);
+    glBindBufferBase(GL_UNIFORM_BUFFER, static_cast<GLuint>(UniformBlock::Camera), cameraBuffer);
+}
+
 void Renderer::setGlfwWindowInstance()
 {
     window = glfwCreateWindow(winWidth, winHeight, name.c_str(), nullptr, nullptr);
@@ -216,6 +244,7 @@ void Renderer::init()
     }
 
     setGlfwFeatures();
+    setUniformBuffers();
     setGlfwCallbacks();
     setImguiParameters();
 
@@ -432,74 +461,498 @@ void Renderer::mouse_callback(GLFWwindow *window, double xposIn, double yposIn)
     Renderer::camera->onMouseEvent(xoffset, yoffset, GL_TRUE);
 }
 
-void Renderer::draw(const RenderCommand &cmd, Shader &shader)
+uint32_t SortKey::depthBits(float distance)
 {
-    shader.activate();
+    // Non-negative floats order like their bit patterns
+    if (!(distance > 0.0f)) distance = 0.0f;
 
-    float aspect = (float)Renderer::winWidth / (float)Renderer::winHeight;
-    shader.setUniform("transform", cmd.transform);
-    shader.setUniform("view", (*Renderer::camera).getViewMatrix());
-    shader.setUniform("projection", (*Renderer::camera).getProjectionMatrix(aspect));
+    uint32_t bits;
+    std::memcpy(&bits, &distance, sizeof(bits));
+    return bits;
+}
+
+uint64_t SortKey::opaque(GLuint shader, GLuint texture, GLuint mesh, float distance)
+{
+    return (uint64_t(OPAQUE_PASS) << 62) |
+        (uint64_t(shader & 0xFF) << 54) |
+        (uint64_t(texture & 0xFFFF) << 38) |
+        (uint64_t(mesh & 0x3FFF) << 24) |
+        uint64_t(depthBits(distance) >> 7); // sign bit is 0, 24 bits remain
+}
+
+uint64_t SortKey::transparent(GLuint texture, GLuint mesh, float distance)
+{
+    return (uint64_t(TRANSPARENT_PASS) << 62) |
+        (uint64_t(0x7FFFFFFF - depthBits(distance)) << 31) |
+        (uint64_t(texture & 0xFFFF) << 15) |
+        uint64_t(mesh & 0x7FFF);
+}
+
+void RenderQueue::sort(std::vector<RenderCommand> &commands)
+{
+    // Keys with their command index are sorted, the commands are moved once at the end.
+    // Buffers are kept between frames, the previous command storage becomes the next target.
+    static std::vector<std::pair<uint64_t, uint32_t>> keys, scratch;
+    static std::vector<RenderCommand> sorted;
+
+    const size_t count = commands.size();
+    if (count < 2) return;
+
+    keys.resize(count);
+    scratch.resize(count);
+    for (size_t i = 0; i < count; ++i) keys[i] = { commands[i].key, static_cast<uint32_t>(i) };
+
+    for (int shift = 0; shift < 64; shift += 8) {
+        size_t histogram[256] = {};
+        for (const auto &entry : keys) histogram[(entry.first >> shift) & 0xFF]++;
+
+        // Every key has the same byte here, nothing would move
+        if (histogram[(keys[0].first >> shift) & 0xFF] == count) continue;
+
+        size_t offset = 0;
+        for (size_t &bucket : histogram) {
+            size_t size = bucket;
+            bucket = offset;
+            offset += size;
+        }
+
+        for (const auto &entry : keys) scratch[histogram[(entry.first >> shift) & 0xFF]++] = entry;
+        keys.swap(scratch);
+    }
 
-    // Set material uniforms from the mesh
-    shader.setUniform("material.diffuse", cmd.mesh->material.diffuse);
-    shader.setUniform("material.specular", cmd.mesh->material.specular);
-    shader.setUniform("material.shininess", cmd.mesh->material.shininess);
-    shader.setUniform("material.transparency", cmd.mesh->material.transparency);
+    sorted.clear();
+    for (const auto &entry : keys) sorted.push_back(commands[entry.second]);
+    commands.swap(sorted);
+}
+
+void RenderQueue::batch(std::vector<RenderCommand>& commands, std::vector<glm::mat4>& instances, bool merge)
+{
+    static std::vector<RenderCommand> batched;
+    batched.clear();
 
-    // Texture Logic
-    if (cmd.mesh->material.texture.id != -1)
+    for (size_t first = 0; first < commands.size();) {
+        // Sorting put the commands of a mesh next to each other, their levels may still interleave
+        size_t end = first + 1;
+        if (merge) {
+            while (end < commands.size() && commands[end].mesh == commands[first].mesh) end++;
+        }
+
+        if (end - first < MIN_INSTANCES) {
+            for (size_t i = first; i < end; ++i) {
+                RenderCommand cmd = commands[i];
+                cmd.instance = static_cast<uint32_t>(instances.size());
+                cmd.instanceCount = 1;
+                instances.push_back(cmd.transform);
+                batched.push_back(cmd);
+            }
+            first = end;
+            continue;
+        }
+
+        // Nearest level first, the run stays roughly front to back
+        for (size_t lod = 0; lod < commands[first].mesh->lods.size(); ++lod) {
+            size_t count = 0;
+            for (size_t i = first; i < end; ++i) count += commands[i].lod == lod;
+            if (count == 0) continue;
+
+            if (count < MIN_INSTANCES) {
+                for (size_t i = first; i < end; ++i) {
+                    if (commands[i].lod != lod) continue;
+                    RenderCommand cmd = commands[i];
+                    cmd.instance = static_cast<uint32_t>(instances.size());
+                    cmd.instanceCount = 1;
+                    instances.push_back(cmd.transform);
+                    batched.push_back(cmd);
+                }
+                continue;
+            }
+
+            RenderCommand cmd = commands[first];
+            cmd.lod = lod;
+            cmd.instance = static_cast<uint32_t>(instances.size());
+            cmd.instanceCount = static_cast<uint32_t>(count);
+            for (size_t i = first; i < end; ++i) {
+                if (commands[i].lod == lod) instances.push_back(commands[i].transform);
+            }
+            batched.push_back(cmd);
+        }
+        first = end;
+    }
+
+    commands.swap(batched);
+}
+
+void MaterialUniforms::resolve(const Shader &shader)
+{
+    positionOffset = shader.getUniform<glm::vec3>("positionOffset");
+    positionScale = shader.getUniform<glm::vec3>("positionScale");
+    octNormals = shader.getUniform<int>("octNormals");
+
+    // Textured variants take the colors from the texture, the others never sample it
+    diffuse = shader.getOptionalUniform<glm::vec3>("material.diffuse");
+    specular = shader.getOptionalUniform<glm::vec3>("material.specular");
+    shininess = shader.getUniform<float>("material.shininess");
+    transparency = shader.getUniform<float>("material.transparency");
+    textureUnit = shader.getOptionalUniform<int>("material.texture.textureUnit");
+    textureScale = shader.getOptionalUniform<glm::vec3>("material.texture.scale");
+}
+
+void Renderer::draw(const RenderCommand &cmd, Shader &shader, bool cullBackfaces)
+{
+    // Uniforms belong to the program, another one needs the per mesh ones again
+    if (state.program != shader.ID)
     {
-        shader.setUniform("material.texture.textureUnit", 0);
-        shader.setUniform("material.texture.isTextured", 1);
-        shader.setUniform("material.texture.scale", cmd.mesh->material.texture.scale);
+        shader.activate();
+        state.program = shader.ID;
+        state.mesh = nullptr;
+        statistics.shaderChanges++;
+
+        auto [found, added] = materialUniforms.try_emplace(shader.ID);
+        if (added) found->second.resolve(shader);
+        state.uniforms = &found->second;
+    }
+
+    const MaterialUniforms &uniforms = *state.uniforms;
 
-        glBindTextureUnit(0, cmd.mesh->material.texture.id);
+    // Instances of the same mesh follow each other after sorting, they share everything below
+    if (state.mesh != cmd.mesh)
+    {
+        // How the vertex shader reads the vertex format of the mesh
+        uniforms.positionOffset.set(cmd.mesh->positionOffset);
+        uniforms.positionScale.set(cmd.mesh->positionScale);
+        uniforms.octNormals.set(cmd.mesh->octNormals ? 1 : 0);
+
+        // Set material uniforms from the mesh
+        uniforms.diffuse.set(cmd.mesh->material.diffuse);
+        uniforms.specular.set(cmd.mesh->material.specular);
+        uniforms.shininess.set(cmd.mesh->material.shininess);
+        uniforms.transparency.set(cmd.mesh->material.transparency);
+
+        uniforms.textureUnit.set(0);
+        uniforms.textureScale.set(cmd.mesh->material.texture.scale);
+
+        state.mesh = cmd.mesh;
+        statistics.meshChanges++;
     }
-    else
+
+    GLuint texture = cmd.mesh->material.texture.id != -1 ? static_cast<GLuint>(cmd.mesh->material.texture.id) : 0;
+    if (state.texture != texture)
     {
-        shader.setUniform("material.texture.isTextured", 0);
-        glBindTextureUnit(0, 0);
+        glBindTextureUnit(0, texture);
+        state.texture = texture;
+        statistics.textureChanges++;
     }
 
-    cmd.mesh->draw(shader);
+    drawGeometry(cmd, cullBackfaces, VertexStream::Full);
 }
 
-void Renderer::execute(Shader &shader)
+void Renderer::drawDepth(const RenderCommand &cmd)
 {
-    // Update Audio
-    Audio::updateListener(camera->Position, camera->Front);
+    if (state.program != depthShader->ID)
+    {
+        depthShader->activate();
+        state.program = depthShader->ID;
+        state.mesh = nullptr;
+        statistics.shaderChanges++;
+    }
 
-    std::sort(queue.opaque.begin(), queue.opaque.end(), [](const RenderCommand &a, const RenderCommand &b)
-              { return a.distance < b.distance; });
+    if (state.mesh != cmd.mesh)
+    {
+        depthPositionOffset.set(cmd.mesh->positionOffset);
+        depthPositionScale.set(cmd.mesh->positionScale);
+        state.mesh = cmd.mesh;
+        statistics.meshChanges++;
+    }
 
-    std::sort(queue.transparent.begin(), queue.transparent.end(), [](const RenderCommand &a, const RenderCommand &b)
-              { return a.distance > b.distance; });
+    // Same clusters and levels as the color pass, anything else would fail its GL_EQUAL test
+    drawGeometry(cmd, true, VertexStream::Position);
+}
 
-    glDepthMask(GL_TRUE);
-    glDisable(GL_BLEND);
-    for (const auto &cmd : queue.opaque)
+void Renderer::drawGeometry(const RenderCommand &cmd, bool cullBackfaces, VertexStream stream)
+{
+    statistics.draws++;
+
+    // Instances of a mesh follow each other, the vertex array stays bound between them
+    GLuint vertexArray = cmd.mesh->vertexArray(stream);
+    if (state.vertexArray != vertexArray)
     {
-        Renderer::draw(cmd, shader);
+        glBindVertexArray(vertexArray);
+        state.vertexArray = vertexArray;
     }
 
-    glEnable(GL_BLEND);
-    glDepthMask(GL_FALSE);
+    // The transform is an instanced attribute for every draw, single commands are one instance
+    glVertexArrayVertexBuffer(vertexArray, InstanceLayout::BINDING, instanceBuffer,
+        static_cast<GLintptr>(cmd.instance) * sizeof(glm::mat4), sizeof(glm::mat4));
+
+    if (cmd.instanceCount > 1)
+    {
+        statistics.instanced += cmd.instanceCount;
+        cmd.mesh->drawInstanced(cmd.lod, static_cast<GLsizei>(cmd.instanceCount));
+        return;
+    }
+
+    // Clusters only exist for the full detail level, a single one is not worth testing
+    if (cmd.lod != 0 || cmd.mesh->meshlets.size() <= 1)
+    {
+        cmd.mesh->draw(cmd.lod);
+        return;
+    }
+
+    // Clusters are culled in the local space of the mesh, the frustum planes come out of the full
+    // clip matrix. A mirroring transform flips the winding, the normal cones do not hold then.
+    Frustum frustum(frame.viewProjection * cmd.transform);
+    glm::vec3 camera = glm::vec3(glm::inverse(cmd.transform) * glm::vec4(frame.viewPos, 1.0f));
+    bool mirrored = glm::determinant(glm::mat3(cmd.transform)) < 0.0f;
+
+    cmd.mesh->draw(frustum, camera, cullBackfaces && !mirrored);
+}
+
+void Renderer::beginFrame()
+{
+    float aspect = (float)Renderer::winWidth / (float)Renderer::winHeight;
+
+    frame.view = camera->getViewMatrix();
+    frame.projection = camera->getProjectionMatrix(aspect);
+    frame.viewProjection = frame.projection * frame.view;
+    frame.viewPos = camera->Position;
+    frame.time = static_cast<float>(glfwGetTime());
+
+    glNamedBufferSubData(cameraBuffer, 0, sizeof(CameraBlock), &frame);
+
+    frustum = Frustum(frame.viewProjection);
+    statistics = RenderStatistics{};
+}
+
+void Renderer::uploadInstances()
+{
+    if (instances.empty()) return;
+
+    // Storage is immutable, a bigger one replaces it with room to grow
+    if (instances.size() > instanceCapacity)
+    {
+        instanceCapacity = std::max(instances.size(), instanceCapacity * 2);
+        if (instanceBuffer) glDeleteBuffers(1, &instanceBuffer);
+        glCreateBuffers(1, &instanceBuffer);
+        glNamedBufferStorage(instanceBuffer, instanceCapacity * sizeof(glm::mat4), nullptr, GL_DYNAMIC_STORAGE_BIT);
+    }
+
+    glNamedBufferSubData(instanceBuffer, 0, instances.size() * sizeof(glm::mat4), instances.data());
+}
 
+void Renderer::resizeTransparency(int width, int height)
+{
+    if (transparency.framebuffer)
+    {
+        glDeleteFramebuffers(1, &transparency.framebuffer);
+        GLuint textures[] = { transparency.accumulation, transparency.revealage, transparency.depth };
+        glDeleteTextures(3, textures);
+    }
+    else
+    {
+        glCreateVertexArrays(1, &transparency.vertexArray);
+        compositeShader = new Shader("resources/shaders/composite.vert", "resources/shaders/composite.frag");
+        compositeShader->getUniform<int>("accumulation").set(0);
+        compositeShader->getUniform<int>("revealage").set(1);
+    }
+
+    transparency.width = width;
+    transparency.height = height;
+
+    // The depth has to match the window format for the blit, which has 24 bits and stencil
+    glCreateTextures(GL_TEXTURE_2D, 1, &transparency.accumulation);
+    glTextureStorage2D(transparency.accumulation, 1, GL_RGBA16F, width, height);
+    glCreateTextures(GL_TEXTURE_2D, 1, &transparency.revealage);
+    glTextureStorage2D(transparency.revealage, 1, GL_R8, width, height);
+    glCreateTextures(GL_TEXTURE_2D, 1, &transparency.depth);
+    glTextureStorage2D(transparency.depth, 1, GL_DEPTH24_STENCIL8, width, height);
+
+    glCreateFramebuffers(1, &transparency.framebuffer);
+    glNamedFramebufferTexture(transparency.framebuffer, GL_COLOR_ATTACHMENT0, transparency.accumulation, 0);
+    glNamedFramebufferTexture(transparency.framebuffer, GL_COLOR_ATTACHMENT1, transparency.revealage, 0);
+    glNamedFramebufferTexture(transparency.framebuffer, GL_DEPTH_STENCIL_ATTACHMENT, transparency.depth, 0);
+
+    const GLenum buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glNamedFramebufferDrawBuffers(transparency.framebuffer, 2, buffers);
+
+    if (glCheckNamedFramebufferStatus(transparency.framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        Logger::error("Transparency framebuffer is incomplete");
+    }
+}
+
+void Renderer::drawTransparentSorted(ShaderVariants &shaders)
+{
     for (const auto &cmd : queue.transparent)
     {
+        Shader &shader = shaders.get(cmd.features);
+
         glEnable(GL_BLEND);
         glDepthMask(GL_FALSE);
         glEnable(GL_CULL_FACE);
         glCullFace(GL_FRONT);
         glEnable(GL_POLYGON_OFFSET_FILL);
         glPolygonOffset(1.0f, 1.0f);
-        Renderer::draw(cmd, shader);
+        Renderer::draw(cmd, shader, false); // the back faces are what this pass draws
 
         glCullFace(GL_BACK);
         glDisable(GL_POLYGON_OFFSET_FILL);
         Renderer::draw(cmd, shader);
     }
+}
+
+void Renderer::drawTransparentWeighted(ShaderVariants &shaders)
+{
+    int width, height;
+    glfwGetFramebufferSize(window, &width, &height);
+    if (width == 0 || height == 0) return;
+
+    if (width != transparency.width || height != transparency.height) resizeTransparency(width, height);
+
+    // The opaque depth keeps hidden transparent fragments out, multisampled depth resolves here
+    glBlitNamedFramebuffer(0, transparency.framebuffer, 0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+    const GLfloat clearAccumulation[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    const GLfloat clearRevealage[] = { 1.0f, 0.0f, 0.0f, 0.0f };
+    glClearNamedFramebufferfv(transparency.framebuffer, GL_COLOR, 0, clearAccumulation);
+    glClearNamedFramebufferfv(transparency.framebuffer, GL_COLOR, 1, clearRevealage);
+
+    // Sums of the weighted colors and the product of the transparencies, in any order.
+    // Both sides of every surface in a single draw.
+    glBindFramebuffer(GL_FRAMEBUFFER, transparency.framebuffer);
+    glEnable(GL_BLEND);
+    glBlendFunci(0, GL_ONE, GL_ONE);
+    glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+    glDepthMask(GL_FALSE);
+    glDisable(GL_CULL_FACE);
+
+    for (const auto &cmd : queue.transparent)
+    {
+        Renderer::draw(cmd, shaders.get(cmd.features | ShaderVariants::WEIGHTED_BLENDED), false);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // Average color over the opaque image, weighted by how much of it the surfaces let through
+    glBlendFunc(GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA);
+    glDisable(GL_DEPTH_TEST);
+
+    compositeShader->activate();
+    glBindTextureUnit(0, transparency.accumulation);
+    glBindTextureUnit(1, transparency.revealage);
+    glBindVertexArray(transparency.vertexArray);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    state.program = compositeShader->ID;
+    state.vertexArray = transparency.vertexArray;
+    state.texture = std::numeric_limits<GLuint>::max();
+    statistics.shaderChanges++;
+    statistics.draws++;
+
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+    glCullFace(GL_BACK);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void Renderer::cullOccluded()
+{
+    if (queue.occluders.empty()) return;
+
+    occlusion.clear(frame.viewProjection);
+    for (const auto &cmd : queue.occluders)
+    {
+        // The simplified levels are not conservative, collapses may move the surface towards
+        // the camera or past the silhouette and hide what is in fact visible
+        const MeshLod &level = cmd.mesh->lods.front();
+        occlusion.rasterize(cmd.mesh->vertices, cmd.mesh->indices.data() + level.indexOffset, level.indexCount, cmd.transform);
+    }
+    occlusion.finish();
+
+    // An occluder is never hidden by itself, its box reaches at least as near as its surface
+    auto hidden = [](const RenderCommand &cmd) {
+        if (!occlusion.isOccluded(cmd.mesh->bounds.transformed(cmd.transform))) return false;
+        statistics.visible--;
+        statistics.occluded++;
+        return true;
+    };
+
+    std::erase_if(queue.opaque, hidden);
+    std::erase_if(queue.transparent, hidden);
+}
+
+void Renderer::execute(ShaderVariants &shaders)
+{
+    // Update Audio
+    Audio::updateListener(camera->Position, camera->Front);
+
+    if (occlusionCulling) cullOccluded();
+
+    // Weighted blending does not depend on the order, the transparent commands are grouped by
+    // program, texture and mesh like the opaque ones so that repeated meshes end up together
+    if (weightedBlended)
+    {
+        for (auto &cmd : queue.transparent)
+        {
+            GLuint program = shaders.get(cmd.features | ShaderVariants::WEIGHTED_BLENDED).ID;
+            GLuint texture = cmd.mesh->material.texture.id != -1 ? static_cast<GLuint>(cmd.mesh->material.texture.id) : 0;
+            cmd.key = SortKey::opaque(program, texture, cmd.mesh->vertexArray(), cmd.distance);
+        }
+    }
+
+    RenderQueue::sort(queue.opaque);
+    RenderQueue::sort(queue.transparent);
+
+    // Sorted blending needs the transparent commands strictly back to front, they are merged only without it
+    instances.clear();
+    RenderQueue::batch(queue.opaque, instances, true);
+    RenderQueue::batch(queue.transparent, instances, weightedBlended);
+    uploadInstances();
+
+    // GUI and other code draw between frames, nothing bound can be trusted
+    state = DrawState{};
+
+    glDepthMask(GL_TRUE);
+    glDisable(GL_BLEND);
+
+    if (depthPrepass && !queue.opaque.empty())
+    {
+        if (!depthShader)
+        {
+            depthShader = new Shader("resources/shaders/depth.vert", "resources/shaders/depth.frag");
+            depthPositionOffset = depthShader->getUniform<glm::vec3>("positionOffset");
+            depthPositionScale = depthShader->getUniform<glm::vec3>("positionScale");
+        }
+
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        for (const auto &cmd : queue.opaque)
+        {
+            Renderer::drawDepth(cmd);
+        }
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+        // Only the nearest surface of every pixel passes, the depth is already final
+        glDepthFunc(GL_EQUAL);
+        glDepthMask(GL_FALSE);
+    }
+
+    for (const auto &cmd : queue.opaque)
+    {
+        Renderer::draw(cmd, shaders.get(cmd.features));
+    }
+
+    glDepthFunc(GL_LESS);
+
+    glEnable(GL_BLEND);
+    glDepthMask(GL_FALSE);
+
+    if (!queue.transparent.empty())
+    {
+        if (weightedBlended) drawTransparentWeighted(shaders);
+        else drawTransparentSorted(shaders);
+    }
+
+    // Nothing outside the frame may modify the vertex array of a mesh by accident
+    glBindVertexArray(0);
 
     glDepthMask(GL_TRUE);
     queue.clear();
@@ -6,8 +6,11 @@
 // 2. Windowing/System headers SECOND
 #include <GLFW/glfw3.h>
 #include <chrono>
+#include <cstdint>
 #include <iostream>
 #include <array>
+#include <limits>
+#include <unordered_map>
 
 // 3. Complex libraries (OpenCV, etc.) LAST
 #include <opencv2/opencv.hpp>
@@ -15,6 +18,8 @@
 #include "logger.hpp"
 #include "camera.hpp"
 #include "mesh.hpp"
+#include "occlusion_culler.hpp"
+#include "shader_variants.hpp"
 
 enum CursorMode {
     LOCKED,
@@ -22,19 +27,101 @@ enum CursorMode {
 };
 
 struct RenderCommand {
-    Mesh* mesh;
+    const Mesh* mesh;
     glm::mat4 transform;
     float distance;
+    size_t lod = 0;
+    // Commands are drawn in ascending key order, see SortKey
+    uint64_t key = 0;
+    // Range of the frame instance buffer, filled by RenderQueue::batch
+    uint32_t instance = 0;
+    uint32_t instanceCount = 1;
+    // ShaderVariants::Feature bits of the material, the pass may add its own
+    uint32_t features = 0;
+};
+
+/*
+    Packed 64-bit sort keys, compared as plain integers.
+    - opaque:      pass (2) | shader (8) | texture (16) | mesh (14) | depth (24),
+                   draws sharing state end up together, front to back among themselves
+    - transparent: pass (2) | inverted depth (31) | texture (16) | mesh (15), strictly back to front
+*/
+class SortKey
+{
+public:
+    enum Pass : uint64_t {
+        OPAQUE_PASS = 0,
+        TRANSPARENT_PASS = 1
+    };
+
+    static uint64_t opaque(GLuint shader, GLuint texture, GLuint mesh, float distance);
+    static uint64_t transparent(GLuint texture, GLuint mesh, float distance);
+
+    // Bits of a distance that sort like the distance, negative ones count as 0
+    static uint32_t depthBits(float distance);
+};
+
+// Work of the last executed frame
+struct RenderStatistics {
+    size_t draws = 0;
+    size_t shaderChanges = 0;
+    size_t textureChanges = 0;
+    size_t meshChanges = 0;
+    size_t instanced = 0; // objects drawn by instanced draws
+    // Meshes Model::submit tested against the frustum
+    size_t visible = 0;
+    size_t culled = 0;
+    // Of the visible ones, those hidden behind the occluders
+    size_t occluded = 0;
+};
+
+// Camera uniform block as std140 lays it out, uploaded once per frame
+struct CameraBlock {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::vec3 viewPos;
+    float time;
+};
+
+static_assert(sizeof(CameraBlock) == 208, "CameraBlock must match the std140 layout of the Camera block");
+
+// Uniforms Renderer::draw sets, resolved once per program. Variants compile out the ones
+// their features do not use, those handles stay invalid.
+struct MaterialUniforms {
+    Uniform<glm::vec3> positionOffset, positionScale;
+    Uniform<int> octNormals;
+
+    Uniform<glm::vec3> diffuse, specular;
+    Uniform<float> shininess, transparency;
+    Uniform<int> textureUnit;
+    Uniform<glm::vec3> textureScale;
+
+    void resolve(const Shader& shader);
 };
 
 struct RenderQueue {
     std::vector<RenderCommand> opaque;
     std::vector<RenderCommand> transparent;
+    // Drawn into the occlusion buffer at full detail, they are queued to be drawn as well
+    std::vector<RenderCommand> occluders;
 
     void clear() {
         opaque.clear();
         transparent.clear();
+        occluders.clear();
     }
+
+    // Stable LSD radix sort by key, 8 bits per pass, passes where all keys agree are skipped
+    static void sort(std::vector<RenderCommand>& commands);
+
+    // Smallest number of commands with the same mesh and level worth an instanced draw,
+    // fewer ones are drawn one by one and keep their cluster culling
+    static const size_t MIN_INSTANCES = 4;
+
+    // Appends the transforms of sorted commands to instances. With merge, runs of the same mesh
+    // and level become a single command, otherwise the order is left exactly as it is.
+    static void batch(std::vector<RenderCommand>& commands, std::vector<glm::mat4>& instances, bool merge);
 };
 
 class Renderer
@@ -67,6 +154,16 @@ public:
     static std::string shadingLanguage;
 
     static RenderQueue queue;
+    static RenderStatistics statistics;
+    // Camera of the current frame as the shaders see it, and its world space frustum
+    static CameraBlock frame;
+    static Frustum frustum;
+
+    static bool occlusionCulling;
+    // Transparency in one unsorted pass with weighted blending instead of the sorted double draw
+    static bool weightedBlended;
+    // Opaque depth first with a position only shader, every visible pixel is then lit once
+    static bool depthPrepass;
 
     static std::vector<RenderCommand> opaque;
     static std::vector<RenderCommand> transparent;
@@ -76,10 +173,14 @@ public:
     static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 
     static void init();
+    // Call once the camera is final for the frame, submissions are culled against it
+    static void beginFrame();
     static void submit(RenderCommand command);
-    static void execute(Shader& shader);
+    // Every command is drawn with the variant of its features
+    static void execute(ShaderVariants& shaders);
 
-    static void draw(const RenderCommand& cmd, Shader& shader);
+    // Clusters of the mesh outside the view are skipped, back facing ones too with cullBackfaces
+    static void draw(const RenderCommand& cmd, Shader& shader, bool cullBackfaces = true);
 
     // Variables for camera movement
     static Camera *camera;
@@ -92,6 +193,54 @@ public:
     
     static GLFWwindow *window;
 private:
+    static std::unordered_map<GLuint, MaterialUniforms> materialUniforms;
+
+    // What the previous draw left bound, forgotten every frame
+    struct DrawState {
+        GLuint program = 0;
+        const MaterialUniforms* uniforms = nullptr; // of the program
+        GLuint texture = std::numeric_limits<GLuint>::max();
+        GLuint vertexArray = std::numeric_limits<GLuint>::max();
+        const Mesh* mesh = nullptr;
+    };
+    static DrawState state;
+
+    static GLuint cameraBuffer;
+
+    // Accumulation and revealage targets of weighted blended transparency, sized like the window
+    struct TransparencyTargets {
+        GLuint framebuffer = 0;
+        GLuint accumulation = 0;
+        GLuint revealage = 0;
+        GLuint depth = 0;
+        GLuint vertexArray = 0; // empty, the composite triangle has no vertices
+        int width = 0;
+        int height = 0;
+    };
+    static TransparencyTargets transparency;
+    static Shader* compositeShader;
+    static void resizeTransparency(int width, int height);
+
+    static void drawTransparentSorted(ShaderVariants& shaders);
+    static void drawTransparentWeighted(ShaderVariants& shaders);
+
+    static Shader* depthShader;
+    static Uniform<glm::vec3> depthPositionOffset, depthPositionScale;
+    static void drawDepth(const RenderCommand& cmd);
+
+    // Binds the vertex array of the stream and the instance range of the command, then draws
+    static void drawGeometry(const RenderCommand& cmd, bool cullBackfaces, VertexStream stream);
+
+    static OcclusionCuller occlusion;
+    // Drops the queued commands hidden behind the occluders
+    static void cullOccluded();
+
+    // Transforms of every command of the frame, commands point into it
+    static std::vector<glm::mat4> instances;
+    static GLuint instanceBuffer;
+    static size_t instanceCapacity;
+    static void uploadInstances();
+
     static std::string name;
     static std::array<int,2> position;
     static int winWidth;
@@ -114,6 +263,7 @@ private:
     static void setImguiParameters();
     static void setWindowHints();
     static void setGlfwFeatures();
+    static void setUniformBuffers();
     static void setGlfwWindowInstance();
     static void setGlfwCallbacks();
 };
\ No newline at end of file
@@ -1,85 +1,170 @@
 #include "shader.hpp"
 #include "logger.hpp"
+#include "program_cache.hpp"
 
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 #include <filesystem>
 #include <vector>
+#include <cstdio>
 #include <stdexcept>
 
 
-Shader::Shader(const std::filesystem::path& VS_file, const std::filesystem::path& FS_file)
+Shader::Shader(const std::filesystem::path& VS_file, const std::filesystem::path& FS_file, const ShaderDefines& defines)
 {
-	std::vector<GLuint> shader_ids;
+	// The cache is keyed by what the driver would compile, defines included
+	std::vector<std::string> sources{ loadSource(VS_file, defines), loadSource(FS_file, defines) };
 
-	shader_ids.push_back(compile_shader(VS_file, GL_VERTEX_SHADER));
-	shader_ids.push_back(compile_shader(FS_file, GL_FRAGMENT_SHADER));
+	ID = ProgramCache::load(sources);
+	if (ID == 0) {
+		std::vector<GLuint> shader_ids;
 
-	ID = link_shader(shader_ids);
+		shader_ids.push_back(compile_shader(sources[0], GL_VERTEX_SHADER));
+		shader_ids.push_back(compile_shader(sources[1], GL_FRAGMENT_SHADER));
+
+		ID = link_shader(shader_ids);
+		ProgramCache::store(sources, ID);
+	}
+
+	// Flags tell the variants apart in the log, the valued defines are the same for all of them
 	shaderName = FS_file.filename().string();
+	std::string flags;
+	for (const auto& [name, value] : defines) {
+		if (value.empty()) flags += (flags.empty() ? "" : ", ") + name;
+	}
+	if (!flags.empty()) shaderName += " (" + flags + ")";
+
+	reflectUniforms();
+	bindUniformBlocks();
 }
 
-void Shader::setUniform(const std::string& name, const float val)
+void Shader::bindUniformBlocks()
 {
-	auto loc = glGetUniformLocation(ID, name.c_str());
-	if (loc == -1) {
-		Logger::warning(shaderName + ": Uniform (float) " + name + " does not exists.");
-		return;
+	static const std::pair<const char*, UniformBlock> blocks[] = {
+		{ "Camera", UniformBlock::Camera },
+		{ "Lights", UniformBlock::Lights },
+	};
+
+	// GLSL 4.10 has no layout(binding = ...), the bindings are set from here instead
+	for (const auto& [name, binding] : blocks) {
+		GLuint index = glGetUniformBlockIndex(ID, name);
+		if (index != GL_INVALID_INDEX) glUniformBlockBinding(ID, index, static_cast<GLuint>(binding));
 	}
+}
+
+void Shader::reflectUniforms()
+{
+	uniforms.clear();
+
+	GLint count = 0, maxLength = 0;
+	glGetProgramInterfaceiv(ID, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count);
+	glGetProgramInterfaceiv(ID, GL_UNIFORM, GL_MAX_NAME_LENGTH, &maxLength);
+
+	std::vector<char> name(static_cast<size_t>(maxLength) + 1);
+	const GLenum properties[] = { GL_BLOCK_INDEX, GL_TYPE, GL_LOCATION, GL_ARRAY_SIZE };
+
+	for (GLint i = 0; i < count; ++i) {
+		GLint values[4];
+		glGetProgramResourceiv(ID, GL_UNIFORM, i, 4, properties, 4, nullptr, values);
+		if (values[0] != -1) continue; // lives in a uniform block, has no location
+
+		glGetProgramResourceName(ID, GL_UNIFORM, i, static_cast<GLsizei>(name.size()), nullptr, name.data());
 
-	glUniform1f(loc, val);
+		UniformInfo info{ values[2], static_cast<GLenum>(values[1]), values[3] };
+		std::string key(name.data());
+
+		// Arrays of plain types come as "name[0]", the other elements follow its location
+		const std::string_view suffix = "[0]";
+		if (key.size() > suffix.size() && key.compare(key.size() - suffix.size(), suffix.size(), suffix) == 0) {
+			std::string base = key.substr(0, key.size() - suffix.size());
+			for (GLint element = 0; element < info.size; ++element) {
+				uniforms[base + "[" + std::to_string(element) + "]"] = UniformInfo{ info.location + element, info.type, 1 };
+			}
+			uniforms[base] = info;
+			continue;
+		}
+
+		uniforms[key] = info;
+	}
+
+	Logger::debug(shaderName + ": " + std::to_string(uniforms.size()) + " active uniforms");
 }
 
-void Shader::setUniform(const std::string& name, const int val)
+const UniformInfo* Shader::findUniform(std::string_view name) const
+{
+	auto found = uniforms.find(name);
+	return found != uniforms.end() ? &found->second : nullptr;
+}
+
+void Shader::warnMissing(std::string_view name) const
+{
+	Logger::warning(shaderName + ": Uniform " + std::string(name) + " does not exists.");
+}
+
+void Shader::warnType(std::string_view name, GLenum type) const
+{
+	char hex[16];
+	std::snprintf(hex, sizeof(hex), "0x%04X", type);
+	Logger::warning(shaderName + ": Uniform " + std::string(name) + " has another type (" + hex + ").");
+}
+
+GLint Shader::findLocation(std::string_view name, const char* type)
 {
-	auto loc = glGetUniformLocation(ID, name.c_str());
-	if (loc == -1) {
-		Logger::warning(shaderName + ": Uniform (int) " + name + " does not exists.");
-		return;
+	const UniformInfo* info = findUniform(name);
+	if (!info) {
+		Logger::warning(shaderName + ": Uniform (" + type + ") " + std::string(name) + " does not exists.");
+		return -1;
 	}
-	glUniform1i(loc, val);
+	return info->location;
+}
+
+void Shader::setUniform(const std::string& name, const float val)
+{
+	auto loc = findLocation(name, "float");
+	if (loc == -1) return;
+
+	glProgramUniform1f(ID, loc, val);
+}
+
+void Shader::setUniform(const std::string& name, const int val)
+{
+	auto loc = findLocation(name, "int");
+	if (loc == -1) return;
+
+	glProgramUniform1i(ID, loc, val);
 }
 
 void Shader::setUniform(const std::string& name, const glm::vec3 val)
 {
-	auto loc = glGetUniformLocation(ID, name.c_str());
-	if (loc == -1) {
-		Logger::warning(shaderName + ": Uniform (vec3) " + name + " does not exists.");
-		return;
-	}
-	glUniform3fv(loc, 1, glm::value_ptr(val));
+	auto loc = findLocation(name, "vec3");
+	if (loc == -1) return;
+
+	glProgramUniform3fv(ID, loc, 1, glm::value_ptr(val));
 }
 
 void Shader::setUniform(const std::string& name, const glm::vec4 val)
 {
-	auto loc = glGetUniformLocation(ID, name.c_str());
-	if (loc == -1) {
-		Logger::warning(shaderName + ": Uniform (vec4) " + name + " does not exists.");
-		return;
-	}
-	glUniform4fv(loc, 1, glm::value_ptr(val));
+	auto loc = findLocation(name, "vec4");
+	if (loc == -1) return;
+
+	glProgramUniform4fv(ID, loc, 1, glm::value_ptr(val));
 }
 
 void Shader::setUniform(const std::string& name, const glm::mat3 val)
 {
-	auto loc = glGetUniformLocation(ID, name.c_str());
-	if (loc == -1) {
-		Logger::warning(shaderName + ": Uniform (mat3) " + name + " does not exists.");
-		return;
-	}
+	auto loc = findLocation(name, "mat3");
+	if (loc == -1) return;
 
-	glUniformMatrix3fv(loc, 1, GL_FALSE, glm::value_ptr(val));
+	glProgramUniformMatrix3fv(ID, loc, 1, GL_FALSE, glm::value_ptr(val));
 }
 
 void Shader::setUniform(const std::string& name, const glm::mat4 val)
 {
-	auto loc = glGetUniformLocation(ID, name.c_str());
-	if (loc == -1) {
-		Logger::warning(shaderName + ": Uniform (mat4) " + name + " does not exists.");
-		return;
-	}
+	auto loc = findLocation(name, "mat4");
+	if (loc == -1) return;
 
-	glUniformMatrix4fv(loc, 1, GL_FALSE, glm::value_ptr(val));
+	glProgramUniformMatrix4fv(ID, loc, 1, GL_FALSE, glm::value_ptr(val));
 }
 
 std::string Shader::getShaderInfoLog(const GLuint obj)
@@ -112,14 +197,34 @@ std::string Shader::getProgramInfoLog(const GLuint obj)
 	return s;
 }
 
-GLuint Shader::compile_shader(const std::filesystem::path& source_file, const GLenum type)
+std::string Shader::loadSource(const std::filesystem::path& source_file, const ShaderDefines& defines)
 {
-	GLuint shader_h = glCreateShader(type);
 	std::string shader_string = textFileRead(source_file);
 	size_t pos = shader_string.find("#version 460");
     if (pos != std::string::npos) {
         shader_string.replace(pos, 12, "#version 410");
     }
+
+	// Defines go right after the #version line, #line keeps the errors pointing into the file
+	if (!defines.empty()) {
+		size_t version = shader_string.find("#version");
+		size_t end = version != std::string::npos ? shader_string.find('\n', version) : std::string::npos;
+		size_t insert = end != std::string::npos ? end + 1 : 0;
+		size_t line = std::count(shader_string.begin(), shader_string.begin() + insert, '\n') + 1;
+
+		std::string block;
+		for (const auto& [name, value] : defines) {
+			block += "#define " + name + (value.empty() ? "" : " " + value) + "\n";
+		}
+		block += "#line " + std::to_string(line) + "\n";
+		shader_string.insert(insert, block);
+	}
+	return shader_string;
+}
+
+GLuint Shader::compile_shader(const std::string& shader_string, const GLenum type)
+{
+	GLuint shader_h = glCreateShader(type);
 	const char* shader_c_str = shader_string.c_str();
 	glShaderSource(shader_h, 1, &shader_c_str, NULL);
 	glCompileShader(shader_h);
@@ -146,6 +251,7 @@ GLuint Shader::link_shader(const std::vector<GLuint> shader_ids)
 		glAttachShader(prog_h, id);
 	}
 
+	ProgramCache::prepare(prog_h);
 	glLinkProgram(prog_h);
 	{
 		GLint status;
@@ -5,15 +5,81 @@
 #include <glm/ext.hpp>
 
 #include <string>
+#include <string_view>
 #include <filesystem>
+#include <functional>
 #include <iostream>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+// Binding points of the uniform blocks shared by all programs, assigned by name after linking
+enum class UniformBlock : GLuint {
+	Camera = 0,
+	Lights = 1
+};
+
+// Preprocessor defines put in front of the sources, a flag has an empty value
+using ShaderDefines = std::vector<std::pair<std::string, std::string>>;
+
+// Active uniform as reported by the program after linking
+struct UniformInfo {
+	GLint location = -1;
+	GLenum type = 0;
+	GLint size = 1; // elements of an array
+};
+
+// Hashes std::string and std::string_view alike, so lookups by view do not allocate
+struct StringHash {
+	using is_transparent = void;
+	size_t operator()(std::string_view text) const { return std::hash<std::string_view>{}(text); }
+};
+
+/*
+	Uniform resolved once, setting it is a single glProgramUniform* call.
+	- the program does not have to be active
+	- handles of missing uniforms are invalid, setting them does nothing (location -1)
+*/
+template <typename T>
+class Uniform {
+public:
+	Uniform() = default;
+
+	void set(const T& value) const;
+	bool isValid() const { return location != -1; }
+
+	// GL types the handle may be bound to
+	static bool accepts(GLenum type);
+
+private:
+	friend class Shader;
+	Uniform(GLuint program, GLint location) : program(program), location(location) {}
+
+	GLuint program{ 0 };
+	GLint location{ -1 };
+};
+
+template <> inline void Uniform<float>::set(const float& value) const { glProgramUniform1f(program, location, value); }
+template <> inline void Uniform<int>::set(const int& value) const { glProgramUniform1i(program, location, value); }
+template <> inline void Uniform<glm::vec2>::set(const glm::vec2& value) const { glProgramUniform2fv(program, location, 1, glm::value_ptr(value)); }
+template <> inline void Uniform<glm::vec3>::set(const glm::vec3& value) const { glProgramUniform3fv(program, location, 1, glm::value_ptr(value)); }
+template <> inline void Uniform<glm::vec4>::set(const glm::vec4& value) const { glProgramUniform4fv(program, location, 1, glm::value_ptr(value)); }
+template <> inline void Uniform<glm::mat3>::set(const glm::mat3& value) const { glProgramUniformMatrix3fv(program, location, 1, GL_FALSE, glm::value_ptr(value)); }
+template <> inline void Uniform<glm::mat4>::set(const glm::mat4& value) const { glProgramUniformMatrix4fv(program, location, 1, GL_FALSE, glm::value_ptr(value)); }
+
+template <> inline bool Uniform<float>::accepts(GLenum type) { return type == GL_FLOAT; }
+template <> inline bool Uniform<int>::accepts(GLenum type) { return type == GL_INT || type == GL_BOOL || type == GL_SAMPLER_2D || type == GL_SAMPLER_BUFFER || type == GL_UNSIGNED_INT_SAMPLER_BUFFER; }
+template <> inline bool Uniform<glm::vec2>::accepts(GLenum type) { return type == GL_FLOAT_VEC2; }
+template <> inline bool Uniform<glm::vec3>::accepts(GLenum type) { return type == GL_FLOAT_VEC3; }
+template <> inline bool Uniform<glm::vec4>::accepts(GLenum type) { return type == GL_FLOAT_VEC4; }
+template <> inline bool Uniform<glm::mat3>::accepts(GLenum type) { return type == GL_FLOAT_MAT3; }
+template <> inline bool Uniform<glm::mat4>::accepts(GLenum type) { return type == GL_FLOAT_MAT4; }
+
 class Shader {
 public:
 	// you can add more constructors for pipeline with GS, TS etc.
 	Shader(void) = default; //does nothing
-	Shader(const std::filesystem::path& VS_file, const std::filesystem::path& FS_file);
+	Shader(const std::filesystem::path& VS_file, const std::filesystem::path& FS_file, const ShaderDefines& defines = {});
 
 	void activate(void) { glUseProgram(ID); };
 	void deactivate(void) { glUseProgram(0); };
@@ -21,9 +87,23 @@ public:
 		deactivate();
 		glDeleteProgram(ID);
 		ID = 0;
+		uniforms.clear();
 	}
 
-	// set uniform according to name 
+	// Active uniform by its GLSL name, nullptr if the program has none such.
+	// Array elements are listed one by one ("pointLights[2].position", "values[3]").
+	const UniformInfo* findUniform(std::string_view name) const;
+
+	// Typed handle for the hot paths, resolve it once and keep it with the shader.
+	// A missing uniform or a type mismatch gives an invalid handle and a warning.
+	template <typename T>
+	Uniform<T> getUniform(std::string_view name) const { return resolveUniform<T>(name, true); }
+
+	// Same without the warning for a missing uniform, for the ones some variants compile out
+	template <typename T>
+	Uniform<T> getOptionalUniform(std::string_view name) const { return resolveUniform<T>(name, false); }
+
+	// set uniform according to name, looked up in the reflected table
 	// https://docs.gl/gl4/glUniform
 	void setUniform(const std::string& name, const float val);
 	void setUniform(const std::string& name, const int val);   
@@ -40,7 +120,33 @@ private:
 	std::string getProgramInfoLog(const GLuint obj);
 	std::string shaderName;
 
-	GLuint compile_shader(const std::filesystem::path& source_file, const GLenum type);
+	std::unordered_map<std::string, UniformInfo, StringHash, std::equal_to<>> uniforms;
+
+	template <typename T>
+	Uniform<T> resolveUniform(std::string_view name, bool required) const {
+		const UniformInfo* info = findUniform(name);
+		if (!info) {
+			if (required) warnMissing(name);
+			return Uniform<T>{};
+		}
+		if (!Uniform<T>::accepts(info->type)) {
+			warnType(name, info->type);
+			return Uniform<T>{};
+		}
+		return Uniform<T>{ ID, info->location };
+	}
+
+	// Lists the active uniforms after linking, blocks members are left out
+	void reflectUniforms();
+	// Points the shared uniform blocks the program uses to their UniformBlock binding
+	void bindUniformBlocks();
+	GLint findLocation(std::string_view name, const char* type);
+	void warnMissing(std::string_view name) const;
+	void warnType(std::string_view name, GLenum type) const;
+
+	// Source as it is compiled, the version patched and the defines in place
+	std::string loadSource(const std::filesystem::path& source_file, const ShaderDefines& defines);
+	GLuint compile_shader(const std::string& shader_string, const GLenum type);
 	GLuint link_shader(const std::vector<GLuint> shader_ids);
 	std::string textFileRead(const std::filesystem::path& filename);
 };
\ No newline at end of file
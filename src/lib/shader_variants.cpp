@@ -0,0 +1,40 @@
+#include "shader_variants.hpp"
+#include "logger.hpp"
+
+#include <utility>
+
+// Define every feature bit turns on
+static const std::pair<ShaderVariants::Feature, const char*> FEATURES[] = {
+    { ShaderVariants::TEXTURED, "TEXTURED" },
+    { ShaderVariants::WEIGHTED_BLENDED, "WEIGHTED_BLENDED" },
+};
+
+ShaderVariants::ShaderVariants(const std::filesystem::path& VS_file, const std::filesystem::path& FS_file, const ShaderDefines& common)
+    : vertexFile(VS_file), fragmentFile(FS_file), common(common)
+{
+}
+
+Shader& ShaderVariants::get(uint32_t features)
+{
+    auto found = variants.find(features);
+    if (found != variants.end()) return found->second;
+
+    ShaderDefines defines = common;
+    for (const auto& [feature, name] : FEATURES) {
+        if (features & feature) defines.emplace_back(name, "");
+    }
+
+    // Nodes of the map do not move, the reference handed out stays valid
+    Shader& shader = variants.emplace(features, Shader(vertexFile, fragmentFile, defines)).first->second;
+    for (const auto& callback : setups) callback(shader);
+
+    Logger::debug("Compiled variant " + std::to_string(features) + " of " + fragmentFile.filename().string() +
+        ", " + std::to_string(variants.size()) + " in total");
+    return shader;
+}
+
+void ShaderVariants::setup(const std::function<void(Shader&)>& callback)
+{
+    setups.push_back(callback);
+    for (auto& [features, shader] : variants) callback(shader);
+}
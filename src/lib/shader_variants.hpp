@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "shader.hpp"
+
+/*
+    Programs built from the same sources, specialized by feature defines.
+    - every combination of features is its own program, compiled the first time it is asked for
+    - the common defines (array sizes and the like) are the same for all of them
+    - the sources test the features with #ifdef, a variant carries no branches for the others
+*/
+class ShaderVariants
+{
+public:
+    enum Feature : uint32_t {
+        TEXTURED = 1 << 0,         // colors come from the material texture
+        WEIGHTED_BLENDED = 1 << 1, // writes the weighted blended transparency targets
+    };
+
+    ShaderVariants(const std::filesystem::path& VS_file, const std::filesystem::path& FS_file, const ShaderDefines& common = {});
+
+    // Program of the combination of features, the reference stays valid
+    Shader& get(uint32_t features);
+
+    // Runs on every variant, the compiled ones now and the others as they are compiled
+    void setup(const std::function<void(Shader&)>& callback);
+
+    size_t size() const { return variants.size(); }
+
+private:
+    std::filesystem::path vertexFile;
+    std::filesystem::path fragmentFile;
+    ShaderDefines common;
+
+    std::vector<std::function<void(Shader&)>> setups;
+    std::unordered_map<uint32_t, Shader> variants;
+};
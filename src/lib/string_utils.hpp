@@ -2,10 +2,15 @@
 
 #include <algorithm> 
 #include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
 #include <locale>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <fstream>
 
@@ -49,4 +54,88 @@ inline std::string readFile(const std::string& filename) {
     }
 
     return content;
-}
\ No newline at end of file
+}
+
+// Returns the next line of the text (without the line break) and advances the text past it.
+inline std::string_view nextLine(std::string_view& text) {
+    size_t end = text.find('\n');
+    std::string_view line = text.substr(0, end);
+    text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+
+    // Files exported on Windows
+    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+    return line;
+}
+
+// Returns the next whitespace delimited token of the text and advances the text past it.
+// Empty result means there are no tokens left.
+inline std::string_view nextToken(std::string_view& text) {
+    size_t begin = text.find_first_not_of(" \t");
+    if (begin == std::string_view::npos) {
+        text = {};
+        return {};
+    }
+
+    size_t end = text.find_first_of(" \t", begin);
+    std::string_view token = text.substr(begin, end - begin);
+    text.remove_prefix(end == std::string_view::npos ? text.size() : end);
+    return token;
+}
+
+// Parses a float from the beginning of the text and advances the text past it.
+// Returns false (and leaves the output untouched) if there is no number.
+inline bool parseNumber(std::string_view& text, float& output) {
+    if (!text.empty() && text.front() == '+') text.remove_prefix(1);
+
+#if defined(__cpp_lib_to_chars)
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), output);
+    if (error != std::errc()) return false;
+    text.remove_prefix(end - text.data());
+    return true;
+#else
+    // Some standard libraries still lack the floating point from_chars,
+    // strtof needs a terminated string, so numbers are copied to the stack.
+    char buffer[64];
+    size_t length = std::min(text.size(), sizeof(buffer) - 1);
+    std::copy_n(text.data(), length, buffer);
+    buffer[length] = '\0';
+
+    char* end = nullptr;
+    float value = std::strtof(buffer, &end);
+    if (end == buffer) return false;
+    output = value;
+    text.remove_prefix(end - buffer);
+    return true;
+#endif
+}
+
+// Parses an integer from the beginning of the text and advances the text past it.
+// Returns false (and leaves the output untouched) if there is no number.
+inline bool parseNumber(std::string_view& text, int& output) {
+    if (!text.empty() && text.front() == '+') text.remove_prefix(1);
+
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), output);
+    if (error != std::errc()) return false;
+    text.remove_prefix(end - text.data());
+    return true;
+}
+
+// Fast non-cryptographic 64-bit hash of the bytes, good enough to detect changed files.
+inline uint64_t hashBytes(std::string_view data, uint64_t seed = 0) {
+    const uint64_t prime = 0x9E3779B97F4A7C15ull;
+    uint64_t hash = seed ^ (data.size() * prime);
+
+    size_t i = 0;
+    for (; i + 8 <= data.size(); i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data.data() + i, sizeof(word));
+        hash = (hash ^ word) * prime;
+        hash ^= hash >> 32;
+    }
+    for (; i < data.size(); ++i) {
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * prime;
+    }
+
+    hash ^= hash >> 29;
+    return hash;
+}
@@ -0,0 +1,120 @@
+#include "texture_cache.hpp"
+#include "mapped_file.hpp"
+#include "cache_file.hpp"
+#include "logger.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+/*
+    File layout, see cache_file.hpp for the conventions:
+    - FileHeader
+    - dependencyCount * (CacheDependency, path)
+    - levelCount * LevelIndex
+    - level data, every level at the offset recorded in its index
+*/
+
+// Bump whenever the layout or the importer output changes
+static const uint32_t TEXTURE_CACHE_VERSION = 1;
+static const char TEXTURE_CACHE_MAGIC[4] = { 'I', 'C', 'P', 'T' };
+
+struct FileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels;
+    uint32_t format;
+    uint32_t compressedFormat;
+    uint32_t levelCount;
+    uint32_t dependencyCount;
+    uint32_t compression;
+};
+
+struct LevelIndex {
+    uint64_t offset;
+    uint64_t size;
+};
+
+std::filesystem::path TextureCache::directory = "cache/textures";
+
+std::filesystem::path TextureCache::cachePath(const std::filesystem::path& source)
+{
+    return CacheFile::path(directory, source, ".texcache");
+}
+
+bool TextureCache::load(const std::filesystem::path& source, Image& output)
+{
+    MappedFile file(cachePath(source));
+    if (!file.isOpen()) return false;
+
+    CacheReader reader(file.view());
+
+    FileHeader header;
+    if (!reader.read(header)) return false;
+    if (std::memcmp(header.magic, TEXTURE_CACHE_MAGIC, sizeof(header.magic)) != 0) return false;
+    if (header.version != TEXTURE_CACHE_VERSION) return false;
+    if (header.compression != static_cast<uint32_t>(TextureLoader::compression)) return false;
+
+    if (!CacheFile::validate(reader, header.dependencyCount, "Texture cache of " + source.string())) return false;
+
+    std::vector<LevelIndex> index;
+    if (!reader.read(index, header.levelCount)) return false;
+
+    Image image;
+    image.width = static_cast<int>(header.width);
+    image.height = static_cast<int>(header.height);
+    image.channels = static_cast<int>(header.channels);
+    image.format = header.format;
+    image.compressedFormat = header.compressedFormat;
+    image.levels.resize(header.levelCount);
+
+    for (uint32_t level = 0; level < header.levelCount; ++level) {
+        if (!reader.seek(index[level].offset) || !reader.read(image.levels[level], index[level].size)) {
+            Logger::warning("Texture cache of " + source.string() + " is truncated");
+            return false;
+        }
+    }
+
+    output = std::move(image);
+    output.cached = true;
+    return true;
+}
+
+void TextureCache::store(const std::filesystem::path& source, const Image& image)
+{
+    std::vector<std::filesystem::path> files{ source };
+
+    std::vector<CacheDependency> states;
+    if (!CacheFile::describe(files, states, "Texture cache of " + source.string())) return;
+
+    CacheFile::write(cachePath(source), [&](CacheWriter& writer) {
+        FileHeader header{};
+        std::memcpy(header.magic, TEXTURE_CACHE_MAGIC, sizeof(header.magic));
+        header.version = TEXTURE_CACHE_VERSION;
+        header.width = static_cast<uint32_t>(image.width);
+        header.height = static_cast<uint32_t>(image.height);
+        header.channels = static_cast<uint32_t>(image.channels);
+        header.format = image.format;
+        header.compressedFormat = image.compressedFormat;
+        header.levelCount = static_cast<uint32_t>(image.levels.size());
+        header.dependencyCount = static_cast<uint32_t>(files.size());
+        header.compression = static_cast<uint32_t>(TextureLoader::compression);
+        writer.write(header);
+
+        CacheFile::writeDependencies(writer, files, states);
+
+        // Level data starts right after the index
+        std::vector<LevelIndex> index(image.levels.size());
+        uint64_t offset = writer.position() + index.size() * sizeof(LevelIndex);
+
+        for (size_t level = 0; level < index.size(); ++level) {
+            index[level].offset = offset;
+            index[level].size = image.levels[level].size();
+            offset += CacheReader::aligned(image.levels[level].size());
+        }
+
+        writer.write(index.data(), index.size() * sizeof(LevelIndex));
+        for (const auto& level : image.levels) writer.write(level.data(), level.size());
+    });
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <filesystem>
+
+#include "texture_loader.hpp"
+
+/*
+    Binary cache of imported textures, every mip level ready for upload (block compressed if enabled).
+    - laid out like KTX2: a header, an index of the levels (offset, size) and the level data
+    - one file per source image in the cache directory, valid while the image stays the same
+      and it was imported with the same compression setting
+*/
+class TextureCache
+{
+public:
+    static std::filesystem::path directory;
+
+    // Returns false if there is no valid cache
+    static bool load(const std::filesystem::path& source, Image& output);
+
+    // Writes the imported image into its cache.
+    static void store(const std::filesystem::path& source, const Image& image);
+
+private:
+    static std::filesystem::path cachePath(const std::filesystem::path& source);
+};
@@ -0,0 +1,286 @@
+#include "texture_compressor.hpp"
+#include "thread_pool.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+size_t TextureCompressor::parallelThreshold = 64 * 64;
+
+static uint16_t packRGB565(const glm::vec3& color)
+{
+    uint16_t r = static_cast<uint16_t>(std::clamp(color.x, 0.0f, 255.0f) * 31.0f / 255.0f + 0.5f);
+    uint16_t g = static_cast<uint16_t>(std::clamp(color.y, 0.0f, 255.0f) * 63.0f / 255.0f + 0.5f);
+    uint16_t b = static_cast<uint16_t>(std::clamp(color.z, 0.0f, 255.0f) * 31.0f / 255.0f + 0.5f);
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+// Same bit replication as the hardware decoder
+static glm::vec3 unpackRGB565(uint16_t color)
+{
+    int r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+    return glm::vec3((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2));
+}
+
+static float distance2(const glm::vec3& a, const glm::vec3& b)
+{
+    glm::vec3 d = a - b;
+    return glm::dot(d, d);
+}
+
+// Picks the closest of the 4 palette colors for every pixel, returns the packed indices
+static uint32_t selectIndices(const glm::vec3 pixels[16], uint16_t color0, uint16_t color1)
+{
+    glm::vec3 palette[4];
+    palette[0] = unpackRGB565(color0);
+    palette[1] = unpackRGB565(color1);
+    palette[2] = (2.0f * palette[0] + palette[1]) / 3.0f;
+    palette[3] = (palette[0] + 2.0f * palette[1]) / 3.0f;
+
+    uint32_t indices = 0;
+    for (int i = 0; i < 16; ++i) {
+        uint32_t best = 0;
+        float bestDistance = std::numeric_limits<float>::max();
+
+        for (uint32_t p = 0; p < 4; ++p) {
+            float d = distance2(pixels[i], palette[p]);
+            if (d < bestDistance) {
+                bestDistance = d;
+                best = p;
+            }
+        }
+
+        indices |= best << (2 * i);
+    }
+
+    return indices;
+}
+
+// Least squares endpoints for fixed indices, false if the indices do not allow a solution
+static bool refineEndpoints(const glm::vec3 pixels[16], uint32_t indices, glm::vec3& end0, glm::vec3& end1)
+{
+    static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+
+    float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+    glm::vec3 ax(0.0f), bx(0.0f);
+
+    for (int i = 0; i < 16; ++i) {
+        float a = weights[(indices >> (2 * i)) & 3];
+        float b = 1.0f - a;
+        aa += a * a;
+        bb += b * b;
+        ab += a * b;
+        ax += a * pixels[i];
+        bx += b * pixels[i];
+    }
+
+    float determinant = aa * bb - ab * ab;
+    if (std::abs(determinant) < 1e-6f) return false;
+
+    end0 = (ax * bb - bx * ab) / determinant;
+    end1 = (bx * aa - ax * ab) / determinant;
+    return true;
+}
+
+static void writeColorBlock(uint16_t color0, uint16_t color1, uint32_t indices, unsigned char output[8])
+{
+    output[0] = color0 & 0xFF;
+    output[1] = color0 >> 8;
+    output[2] = color1 & 0xFF;
+    output[3] = color1 >> 8;
+    for (int i = 0; i < 4; ++i) output[4 + i] = (indices >> (8 * i)) & 0xFF;
+}
+
+// Sum of squared errors of a candidate block
+static float blockError(const glm::vec3 pixels[16], uint16_t color0, uint16_t color1, uint32_t indices)
+{
+    glm::vec3 palette[4];
+    palette[0] = unpackRGB565(color0);
+    palette[1] = unpackRGB565(color1);
+    palette[2] = (2.0f * palette[0] + palette[1]) / 3.0f;
+    palette[3] = (palette[0] + 2.0f * palette[1]) / 3.0f;
+
+    float error = 0.0f;
+    for (int i = 0; i < 16; ++i) error += distance2(pixels[i], palette[(indices >> (2 * i)) & 3]);
+    return error;
+}
+
+// Endpoints are ordered color0 > color1, which selects the 4 color mode
+static void orderEndpoints(uint16_t& color0, uint16_t& color1)
+{
+    if (color0 < color1) std::swap(color0, color1);
+}
+
+void TextureCompressor::encodeBC1(const unsigned char block[16][4], unsigned char output[8])
+{
+    glm::vec3 pixels[16];
+    glm::vec3 mean(0.0f);
+    for (int i = 0; i < 16; ++i) {
+        pixels[i] = glm::vec3(block[i][0], block[i][1], block[i][2]);
+        mean += pixels[i];
+    }
+    mean /= 16.0f;
+
+    // Principal axis of the colors by power iteration on their covariance
+    float xx = 0, xy = 0, xz = 0, yy = 0, yz = 0, zz = 0;
+    for (const glm::vec3& p : pixels) {
+        glm::vec3 d = p - mean;
+        xx += d.x * d.x; xy += d.x * d.y; xz += d.x * d.z;
+        yy += d.y * d.y; yz += d.y * d.z; zz += d.z * d.z;
+    }
+
+    glm::vec3 axis(1.0f);
+    for (int iteration = 0; iteration < 8; ++iteration) {
+        glm::vec3 next(xx * axis.x + xy * axis.y + xz * axis.z,
+                       xy * axis.x + yy * axis.y + yz * axis.z,
+                       xz * axis.x + yz * axis.y + zz * axis.z);
+        float length = glm::length(next);
+        if (length < 1e-6f) break;
+        axis = next / length;
+    }
+
+    // Extremes along the axis, pulled in a little since the palette interpolates
+    float low = std::numeric_limits<float>::max(), high = std::numeric_limits<float>::lowest();
+    for (const glm::vec3& p : pixels) {
+        float t = glm::dot(p - mean, axis);
+        low = std::min(low, t);
+        high = std::max(high, t);
+    }
+
+    float inset = (high - low) / 16.0f;
+    glm::vec3 end0 = mean + axis * (high - inset);
+    glm::vec3 end1 = mean + axis * (low + inset);
+
+    uint16_t color0 = packRGB565(end0), color1 = packRGB565(end1);
+    orderEndpoints(color0, color1);
+
+    if (color0 == color1) {
+        writeColorBlock(color0, color1, 0, output);
+        return;
+    }
+
+    uint32_t indices = selectIndices(pixels, color0, color1);
+    float error = blockError(pixels, color0, color1, indices);
+
+    // One least squares pass, kept only if it does better
+    glm::vec3 refined0, refined1;
+    if (refineEndpoints(pixels, indices, refined0, refined1)) {
+        uint16_t candidate0 = packRGB565(refined0), candidate1 = packRGB565(refined1);
+        orderEndpoints(candidate0, candidate1);
+
+        if (candidate0 != candidate1) {
+            uint32_t candidateIndices = selectIndices(pixels, candidate0, candidate1);
+            float candidateError = blockError(pixels, candidate0, candidate1, candidateIndices);
+
+            if (candidateError < error) {
+                color0 = candidate0;
+                color1 = candidate1;
+                indices = candidateIndices;
+            }
+        }
+    }
+
+    writeColorBlock(color0, color1, indices, output);
+}
+
+void TextureCompressor::encodeBC3(const unsigned char block[16][4], unsigned char output[16])
+{
+    unsigned char low = 255, high = 0;
+    for (int i = 0; i < 16; ++i) {
+        low = std::min(low, block[i][3]);
+        high = std::max(high, block[i][3]);
+    }
+
+    // alpha0 > alpha1 selects the 8 value mode, 6 interpolated steps in between
+    int palette[8] = { high, low };
+    for (int i = 1; i <= 6; ++i) palette[i + 1] = ((7 - i) * high + i * low + 3) / 7;
+
+    uint64_t indices = 0;
+    if (high != low) {
+        for (int i = 0; i < 16; ++i) {
+            uint64_t best = 0;
+            int bestDistance = 256;
+
+            for (int p = 0; p < 8; ++p) {
+                int d = std::abs(palette[p] - block[i][3]);
+                if (d < bestDistance) {
+                    bestDistance = d;
+                    best = p;
+                }
+            }
+
+            indices |= best << (3 * i);
+        }
+    }
+
+    output[0] = high;
+    output[1] = low;
+    for (int i = 0; i < 6; ++i) output[2 + i] = (indices >> (8 * i)) & 0xFF;
+
+    encodeBC1(block, output + 8);
+}
+
+size_t TextureCompressor::levelSize(GLenum format, int width, int height)
+{
+    size_t blockSize = format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? 8 : 16;
+    return static_cast<size_t>((width + 3) / 4) * static_cast<size_t>((height + 3) / 4) * blockSize;
+}
+
+bool TextureCompressor::compress(Image& image)
+{
+    if (image.compressedFormat != 0 || (image.channels != 3 && image.channels != 4)) return false;
+
+    const int channels = image.channels;
+
+    bool opaque = true;
+    if (channels == 4) {
+        const std::vector<unsigned char>& pixels = image.levels[0];
+        for (size_t i = 3; i < pixels.size() && opaque; i += 4) opaque = pixels[i] == 255;
+    }
+
+    const GLenum format = opaque ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    const size_t blockSize = opaque ? 8 : 16;
+
+    int width = image.width;
+    int height = image.height;
+
+    for (std::vector<unsigned char>& level : image.levels) {
+        const int blocksX = (width + 3) / 4;
+        const int blocksY = (height + 3) / 4;
+
+        std::vector<unsigned char> blocks(levelSize(format, width, height));
+
+        parallelFor(blocksY, parallelThreshold / blocksX, [&](size_t begin, size_t end) {
+            unsigned char block[16][4];
+
+            for (size_t by = begin; by < end; ++by) {
+                for (int bx = 0; bx < blocksX; ++bx) {
+                    for (int i = 0; i < 16; ++i) {
+                        int x = std::min(bx * 4 + (i & 3), width - 1);
+                        int y = std::min(static_cast<int>(by) * 4 + (i >> 2), height - 1);
+                        const unsigned char* pixel = level.data() + (static_cast<size_t>(y) * width + x) * channels;
+
+                        block[i][0] = pixel[0];
+                        block[i][1] = pixel[1];
+                        block[i][2] = pixel[2];
+                        block[i][3] = channels == 4 ? pixel[3] : 255;
+                    }
+
+                    unsigned char* output = blocks.data() + (by * blocksX + bx) * blockSize;
+                    if (opaque) encodeBC1(block, output);
+                    else encodeBC3(block, output);
+                }
+            }
+        });
+
+        level = std::move(blocks);
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+
+    image.compressedFormat = format;
+    return true;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstddef>
+
+#include "texture_loader.hpp"
+
+/*
+    CPU encoder for the S3TC block formats, every 4x4 pixel block becomes
+    - BC1 (DXT1): 8 bytes, two RGB565 endpoints and 2-bit indices, opaque images
+    - BC3 (DXT5): 16 bytes, an 8 value alpha block followed by a BC1 color block
+    Edge blocks of sizes that are not a multiple of 4 repeat the last row/column.
+*/
+class TextureCompressor
+{
+public:
+    // Levels with at least this many blocks are encoded on all cores
+    static size_t parallelThreshold;
+
+    // Replaces the levels of a 3 or 4 channel image with BC1 (opaque) or BC3 (translucent) blocks
+    // and sets its compressed format. Returns false and leaves other images untouched.
+    static bool compress(Image& image);
+
+    // Size of a compressed level in bytes
+    static size_t levelSize(GLenum format, int width, int height);
+
+    // Blocks are 16 RGBA pixels, row by row
+    static void encodeBC1(const unsigned char block[16][4], unsigned char output[8]);
+    static void encodeBC3(const unsigned char block[16][4], unsigned char output[16]);
+};
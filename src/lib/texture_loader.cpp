@@ -0,0 +1,221 @@
+#include "texture_loader.hpp"
+#include "logger.hpp"
+#include "thread_pool.hpp"
+#include "texture_cache.hpp"
+#include "texture_compressor.hpp"
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+
+size_t TextureLoader::parallelThreshold = 256 * 256;
+bool TextureLoader::compression = true;
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Averages 2x2 blocks of the source into the rows [begin, end) of the destination.
+// The last row/column of odd sized levels is reused instead of sampling outside.
+static void downsample(const unsigned char* source, int width, int height, unsigned char* destination, int channels, int begin, int end)
+{
+    const int targetWidth = std::max(width / 2, 1);
+
+    for (int y = begin; y < end; ++y) {
+        const unsigned char* row0 = source + static_cast<size_t>(std::min(2 * y, height - 1)) * width * channels;
+        const unsigned char* row1 = source + static_cast<size_t>(std::min(2 * y + 1, height - 1)) * width * channels;
+        unsigned char* output = destination + static_cast<size_t>(y) * targetWidth * channels;
+
+        for (int x = 0; x < targetWidth; ++x) {
+            const int x0 = std::min(2 * x, width - 1) * channels;
+            const int x1 = std::min(2 * x + 1, width - 1) * channels;
+
+            for (int c = 0; c < channels; ++c) {
+                output[x * channels + c] = static_cast<unsigned char>((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+            }
+        }
+    }
+}
+
+// Copies one row of BGR(A) pixels as RGB(A), fixed channel count so the loop vectorizes
+template <int Channels>
+static void swizzleRow(const unsigned char* source, unsigned char* destination, int width)
+{
+    for (int x = 0; x < width; ++x) {
+        destination[0] = source[2];
+        destination[1] = source[1];
+        destination[2] = source[0];
+        if constexpr (Channels == 4) destination[3] = source[3];
+
+        source += Channels;
+        destination += Channels;
+    }
+}
+
+GLuint TextureLoader::load(const std::filesystem::path& path)
+{
+    Image image;
+    if (!import(path, image)) return 0;
+    return upload(image, path);
+}
+
+bool TextureLoader::import(const std::filesystem::path& path, Image& output)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    if (TextureCache::load(path, output)) {
+        output.timings.decode = millisecondsSince(start);
+        return true;
+    }
+
+    if (!decode(path, output)) return false;
+
+    if (compression) {
+        start = std::chrono::steady_clock::now();
+        TextureCompressor::compress(output);
+        output.timings.compress = millisecondsSince(start);
+    }
+
+    TextureCache::store(path, output);
+    return true;
+}
+
+bool TextureLoader::decode(const std::filesystem::path& path, Image& output)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    cv::Mat img = cv::imread(path.string(), cv::IMREAD_UNCHANGED);
+
+    if (img.empty()) {
+        Logger::error("Failed to load texture at path: " + path.string());
+        return false;
+    }
+
+    output.timings.decode = millisecondsSince(start);
+    start = std::chrono::steady_clock::now();
+
+    output.width = img.cols;
+    output.height = img.rows;
+    output.channels = img.channels();
+
+    // OpenCV loads BGR(A) rows top to bottom, OpenGL wants RGB(A) bottom to top
+    static const GLenum formats[] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+    if (output.channels < 1 || output.channels > 4) {
+        Logger::error("Unsupported channel count " + std::to_string(output.channels) + " of texture " + path.string());
+        return false;
+    }
+    output.format = formats[output.channels - 1];
+
+    // Flip and swizzle in one pass over the pixels
+    const size_t rowSize = static_cast<size_t>(output.width) * output.channels;
+
+    output.levels.assign(1, std::vector<unsigned char>(rowSize * output.height));
+    unsigned char* pixels = output.levels[0].data();
+
+    for (int y = 0; y < output.height; ++y) {
+        const unsigned char* source = img.ptr(output.height - 1 - y);
+        unsigned char* destination = pixels + y * rowSize;
+
+        if (output.channels == 3) swizzleRow<3>(source, destination, output.width);
+        else if (output.channels == 4) swizzleRow<4>(source, destination, output.width);
+        else std::copy(source, source + rowSize, destination);
+    }
+
+    output.timings.convert = millisecondsSince(start);
+    start = std::chrono::steady_clock::now();
+
+    generateMipmaps(output);
+
+    output.timings.mipmaps = millisecondsSince(start);
+    return true;
+}
+
+void TextureLoader::generateMipmaps(Image& image)
+{
+    int width = image.width;
+    int height = image.height;
+
+    image.levels.resize(1);
+
+    while (width > 1 || height > 1) {
+        const int targetWidth = std::max(width / 2, 1);
+        const int targetHeight = std::max(height / 2, 1);
+
+        std::vector<unsigned char> level(static_cast<size_t>(targetWidth) * targetHeight * image.channels);
+        const unsigned char* source = image.levels.back().data();
+
+        // Bands of rows are independent
+        parallelFor(targetHeight, parallelThreshold / targetWidth, [&](size_t begin, size_t end) {
+            downsample(source, width, height, level.data(), image.channels, static_cast<int>(begin), static_cast<int>(end));
+        });
+
+        image.levels.push_back(std::move(level));
+        width = targetWidth;
+        height = targetHeight;
+    }
+}
+
+GLuint TextureLoader::upload(const Image& image, const std::filesystem::path& path)
+{
+    auto start = std::chrono::steady_clock::now();
+
+	GLuint textureID;
+
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+
+    // Rows are tightly packed, RGB rows of odd widths are not 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    int width = image.width;
+    int height = image.height;
+    size_t bytes = 0;
+
+    for (size_t level = 0; level < image.levels.size(); ++level) {
+        const std::vector<unsigned char>& pixels = image.levels[level];
+
+        if (image.compressedFormat != 0) {
+            glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), image.compressedFormat, width, height, 0, static_cast<GLsizei>(pixels.size()), pixels.data());
+        }
+        else {
+            glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), image.format, width, height, 0, image.format, GL_UNSIGNED_BYTE, pixels.data());
+        }
+
+        bytes += pixels.size();
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(image.levels.size()) - 1);
+
+    // Wrapping/Filtering (Same as your current code)
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    std::ostringstream message;
+    message << std::fixed << std::setprecision(2)
+        << "Created texture " << textureID << " " << path.string() << " (" << image.width << "x" << image.height
+        << ", " << image.levels.size() << " levels, " << (image.compressedFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? "BC1" : image.compressedFormat != 0 ? "BC3" : "uncompressed")
+        << ", " << bytes / 1024 << " KiB): ";
+
+    if (image.cached) {
+        message << "cache read " << image.timings.decode << " ms";
+    }
+    else {
+        message << "decode " << image.timings.decode
+            << " ms, flip/swizzle " << image.timings.convert
+            << " ms, mipmaps " << image.timings.mipmaps
+            << " ms, compress " << image.timings.compress << " ms";
+    }
+
+    message << ", upload " << millisecondsSince(start) << " ms";
+    Logger::info(message.str());
+
+    return textureID;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <GL/glew.h>
+#include <filesystem>
+#include <vector>
+
+// Decoded pixels with their mip chain, rows bottom to top as OpenGL expects them
+struct Image {
+    int width = 0;
+    int height = 0;
+    int channels = 3;
+    GLenum format = GL_RGB;
+    // Block compressed internal format, 0 if the levels hold plain pixels
+    GLenum compressedFormat = 0;
+
+    // Level 0 first, every next one half the size of the previous (at least 1 pixel)
+    std::vector<std::vector<unsigned char>> levels;
+
+    // Milliseconds spent in each step, for the load log
+    struct {
+        double decode = 0.0;
+        double convert = 0.0;
+        double mipmaps = 0.0;
+        double compress = 0.0;
+    } timings;
+    // Read from the texture cache, decoding was skipped
+    bool cached = false;
+};
+
+class TextureLoader
+{
+public:
+    // Levels with at least this many pixels are downsampled on all cores
+    static size_t parallelThreshold;
+
+    // Block compress RGB(A) textures (BC1/BC3) when they are imported
+    static bool compression;
+
+    // Imports the image and uploads it (with mipmaps) into a new texture.
+    // Returns 0 if the image could not be loaded.
+    static GLuint load(const std::filesystem::path& path);
+
+    // CPU half of load, safe to call from any thread. Reads the texture cache if it is valid,
+    // otherwise decodes, compresses and stores the result there. Returns false if the image could not be loaded.
+    static bool import(const std::filesystem::path& path, Image& output);
+
+    // Decodes the image and builds its mip chain, no caching and no compression.
+    static bool decode(const std::filesystem::path& path, Image& output);
+
+    // GPU half of load, main thread only.
+    static GLuint upload(const Image& image, const std::filesystem::path& path = {});
+
+    // Appends box filtered levels down to 1x1 after level 0.
+    static void generateMipmaps(Image& image);
+};
@@ -0,0 +1,64 @@
+#include "thread_pool.hpp"
+#include "logger.hpp"
+
+#include <exception>
+
+ThreadPool::ThreadPool(size_t threads)
+{
+    if (threads == 0) {
+        unsigned int cores = std::thread::hardware_concurrency();
+        threads = cores > 1 ? cores - 1 : 1;
+    }
+
+    workers.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) {
+        workers.emplace_back(&ThreadPool::run, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    available.notify_all();
+
+    for (std::thread& worker : workers) worker.join();
+}
+
+void ThreadPool::submit(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+    available.notify_one();
+}
+
+void ThreadPool::run()
+{
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            available.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (jobs.empty()) return;
+
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        // Last resort, a failing job must not take the worker (and the application) down.
+        // Jobs with state to clean up catch their own errors, see AssetRegistry.
+        try {
+            job();
+        }
+        catch (const std::exception& e) {
+            Logger::error(std::string("Background job failed: ") + e.what());
+        }
+        catch (...) {
+            Logger::error("Background job failed");
+        }
+    }
+}
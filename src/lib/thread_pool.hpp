@@ -0,0 +1,60 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+    Fixed set of worker threads running submitted jobs in FIFO order.
+    - jobs must not wait for other jobs of the same pool, they could deadlock it
+    - the destructor finishes the queued jobs before joining the workers
+*/
+class ThreadPool
+{
+public:
+    // 0 threads means one per core, minus the main thread
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> job);
+    size_t size() const { return workers.size(); }
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable available;
+    bool stopping = false;
+
+    void run();
+};
+
+// Runs body(begin, end) over bands of [0, count) on short lived threads, the caller takes
+// the first band. Never waits on a pool, so it is safe to use inside pool jobs.
+// Counts below the threshold run on the calling thread only.
+inline void parallelFor(size_t count, size_t threshold, const std::function<void(size_t, size_t)>& body)
+{
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    if (count < threshold) threads = 1;
+    threads = std::min(threads, count);
+    if (threads <= 1) {
+        if (count > 0) body(0, count);
+        return;
+    }
+
+    size_t band = (count + threads - 1) / threads;
+    std::vector<std::thread> workers;
+
+    for (size_t begin = band; begin < count; begin += band) {
+        workers.emplace_back(body, begin, std::min(begin + band, count));
+    }
+
+    body(0, band);
+    for (std::thread& worker : workers) worker.join();
+}
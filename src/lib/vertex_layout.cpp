@@ -0,0 +1,225 @@
+#include "vertex_layout.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+struct CompactVertex {
+    glm::vec3 position;
+    int16_t normal[2];
+    uint16_t uv[2];
+};
+
+struct QuantizedVertex {
+    uint16_t position[3];
+    uint16_t padding;
+    int16_t normal[2];
+    uint16_t uv[2];
+};
+
+static_assert(sizeof(CompactVertex) == 20, "CompactVertex must stay tightly packed");
+static_assert(sizeof(QuantizedVertex) == 16, "QuantizedVertex must stay tightly packed");
+
+void VertexLayout::apply(GLuint vao, GLuint binding) const
+{
+    for (const VertexAttribute& attribute : attributes) {
+        glEnableVertexArrayAttrib(vao, attribute.location);
+        glVertexArrayAttribFormat(vao, attribute.location, attribute.components, attribute.type, attribute.normalized, attribute.offset);
+        glVertexArrayAttribBinding(vao, attribute.location, binding);
+    }
+}
+
+void InstanceLayout::apply(GLuint vao)
+{
+    for (GLuint column = 0; column < 4; ++column) {
+        glEnableVertexArrayAttrib(vao, LOCATION + column);
+        glVertexArrayAttribFormat(vao, LOCATION + column, 4, GL_FLOAT, GL_FALSE, column * sizeof(glm::vec4));
+        glVertexArrayAttribBinding(vao, LOCATION + column, BINDING);
+    }
+    glVertexArrayBindingDivisor(vao, BINDING, 1);
+}
+
+static GLuint typeSize(GLenum type)
+{
+    switch (type) {
+    case GL_FLOAT: return 4;
+    case GL_SHORT:
+    case GL_UNSIGNED_SHORT:
+    case GL_HALF_FLOAT: return 2;
+    default: return 1;
+    }
+}
+
+EncodedVertices EncodedVertices::positionsOnly() const
+{
+    EncodedVertices output;
+    output.format = format;
+    output.positionOffset = positionOffset;
+    output.positionScale = positionScale;
+
+    auto position = std::find_if(layout.attributes.begin(), layout.attributes.end(), [](const VertexAttribute& attribute) { return attribute.location == 0; });
+    if (position == layout.attributes.end() || layout.stride == 0) return output;
+
+    const GLuint size = position->components * typeSize(position->type);
+    const GLuint stride = (size + 3) & ~3u;
+    const size_t count = data.size() / layout.stride;
+
+    output.layout.stride = static_cast<GLsizei>(stride);
+    output.layout.attributes = { { 0, position->components, position->type, position->normalized, 0 } };
+
+    output.data.assign(count * stride, 0);
+    for (size_t i = 0; i < count; ++i) {
+        std::memcpy(output.data.data() + i * stride, data.data() + i * layout.stride + position->offset, size);
+    }
+    return output;
+}
+
+static int16_t toSnorm16(float value)
+{
+    return static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+static uint16_t toUnorm16(float value)
+{
+    return static_cast<uint16_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
+}
+
+void VertexEncoder::encodeOctahedral(const glm::vec3& normal, int16_t output[2])
+{
+    float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    if (length == 0.0f) {
+        output[0] = output[1] = 0;
+        return;
+    }
+
+    glm::vec3 n = normal / length;
+    float x = n.x, y = n.y;
+
+    // The lower hemisphere is folded over the diagonals
+    if (n.z < 0.0f) {
+        x = (1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+        y = (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+    }
+
+    output[0] = toSnorm16(x);
+    output[1] = toSnorm16(y);
+}
+
+glm::vec3 VertexEncoder::decodeOctahedral(const int16_t input[2])
+{
+    float x = std::max(input[0] / 32767.0f, -1.0f);
+    float y = std::max(input[1] / 32767.0f, -1.0f);
+    glm::vec3 n(x, y, 1.0f - std::abs(x) - std::abs(y));
+
+    float t = std::max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return glm::normalize(n);
+}
+
+uint16_t VertexEncoder::toHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    if (exponent >= 31) return static_cast<uint16_t>(sign | 0x7C00); // overflow to infinity, NaN is not expected here
+    if (exponent <= 0) {
+        if (exponent < -10) return static_cast<uint16_t>(sign);
+        // Subnormal half, round to nearest
+        mantissa |= 0x800000;
+        uint32_t shift = static_cast<uint32_t>(14 - exponent);
+        return static_cast<uint16_t>(sign | ((mantissa + (1u << (shift - 1))) >> shift));
+    }
+
+    // Round to nearest, a carry correctly bumps the exponent
+    uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    if (mantissa & 0x1000) half++;
+    return static_cast<uint16_t>(half);
+}
+
+EncodedVertices VertexEncoder::encode(const std::vector<Vertex>& vertices, VertexFormat format, const AABB& grid)
+{
+    EncodedVertices output;
+    output.format = format;
+
+    if (format == VertexFormat::Standard) {
+        output.layout.stride = sizeof(Vertex);
+        output.layout.attributes = {
+            { 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Position) },
+            { 1, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Normal) },
+            { 2, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, UVs) },
+        };
+
+        output.data.resize(vertices.size() * sizeof(Vertex));
+        std::memcpy(output.data.data(), vertices.data(), output.data.size());
+        return output;
+    }
+
+    output.octNormals = true;
+
+    // unorm16 keeps more precision for UVs inside [0, 1], repeating ones need half floats
+    bool unitUVs = std::all_of(vertices.begin(), vertices.end(), [](const Vertex& vertex) {
+        return vertex.UVs.x >= 0.0f && vertex.UVs.x <= 1.0f && vertex.UVs.y >= 0.0f && vertex.UVs.y <= 1.0f;
+    });
+
+    auto packUV = [unitUVs](float value) { return unitUVs ? toUnorm16(value) : toHalf(value); };
+    const GLenum uvType = unitUVs ? GL_UNSIGNED_SHORT : GL_HALF_FLOAT;
+    const GLboolean uvNormalized = unitUVs ? GL_TRUE : GL_FALSE;
+
+    if (format == VertexFormat::Compact) {
+        output.layout.stride = sizeof(CompactVertex);
+        output.layout.attributes = {
+            { 0, 3, GL_FLOAT, GL_FALSE, offsetof(CompactVertex, position) },
+            { 1, 2, GL_SHORT, GL_TRUE, offsetof(CompactVertex, normal) },
+            { 2, 2, uvType, uvNormalized, offsetof(CompactVertex, uv) },
+        };
+
+        std::vector<CompactVertex> packed(vertices.size());
+        for (size_t i = 0; i < vertices.size(); ++i) {
+            packed[i].position = vertices[i].Position;
+            encodeOctahedral(vertices[i].Normal, packed[i].normal);
+            packed[i].uv[0] = packUV(vertices[i].UVs.x);
+            packed[i].uv[1] = packUV(vertices[i].UVs.y);
+        }
+
+        output.data.resize(packed.size() * sizeof(CompactVertex));
+        std::memcpy(output.data.data(), packed.data(), output.data.size());
+        return output;
+    }
+
+    output.layout.stride = sizeof(QuantizedVertex);
+    output.layout.attributes = {
+        { 0, 3, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(QuantizedVertex, position) },
+        { 1, 2, GL_SHORT, GL_TRUE, offsetof(QuantizedVertex, normal) },
+        { 2, 2, uvType, uvNormalized, offsetof(QuantizedVertex, uv) },
+    };
+
+    // Flat axes get a unit extent, every position maps to 0 there
+    glm::vec3 extent = grid.max - grid.min;
+    for (int axis = 0; axis < 3; ++axis) {
+        if (extent[axis] <= 0.0f) extent[axis] = 1.0f;
+    }
+
+    output.positionOffset = grid.min;
+    output.positionScale = extent;
+
+    std::vector<QuantizedVertex> packed(vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        glm::vec3 relative = (vertices[i].Position - grid.min) / extent;
+        for (int axis = 0; axis < 3; ++axis) packed[i].position[axis] = toUnorm16(relative[axis]);
+        packed[i].padding = 0;
+
+        encodeOctahedral(vertices[i].Normal, packed[i].normal);
+        packed[i].uv[0] = packUV(vertices[i].UVs.x);
+        packed[i].uv[1] = packUV(vertices[i].UVs.y);
+    }
+
+    output.data.resize(packed.size() * sizeof(QuantizedVertex));
+    std::memcpy(output.data.data(), packed.data(), output.data.size());
+    return output;
+}
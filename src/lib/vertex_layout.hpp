@@ -0,0 +1,74 @@
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+#include "vertex.hpp"
+#include "physics.hpp"
+
+/*
+    GPU side vertex formats, the CPU side always keeps the full Vertex.
+    - Standard:  float3 position, float3 normal, float2 UVs (32 bytes)
+    - Compact:   float3 position, octahedral snorm16x2 normal, unorm16x2 or half2 UVs (20 bytes)
+    - Quantized: Compact with unorm16x3 positions relative to a grid (16 bytes),
+                 the shader restores them with positionOffset + position * positionScale
+*/
+enum class VertexFormat {
+    Standard,
+    Compact,
+    Quantized
+};
+
+struct VertexAttribute {
+    GLuint location;
+    GLint components;
+    GLenum type;
+    GLboolean normalized;
+    GLuint offset;
+};
+
+struct VertexLayout {
+    GLsizei stride = 0;
+    std::vector<VertexAttribute> attributes;
+
+    // Sets the attribute formats of the VAO and maps them to the binding point
+    void apply(GLuint vao, GLuint binding) const;
+};
+
+// Per instance model matrix, four vec4 columns read once per instance from their own binding point
+struct InstanceLayout {
+    static const GLuint BINDING = 1;
+    static const GLuint LOCATION = 3;
+
+    static void apply(GLuint vao);
+};
+
+// Vertices converted to one of the formats, with what the shader needs to read them back
+struct EncodedVertices {
+    VertexFormat format = VertexFormat::Standard;
+    VertexLayout layout;
+    std::vector<unsigned char> data;
+
+    glm::vec3 positionOffset{ 0.0f };
+    glm::vec3 positionScale{ 1.0f };
+    bool octNormals = false;
+
+    // The position attribute alone, packed with a 4 byte aligned stride, for depth only passes.
+    // Keeps the encoding, positions read from it come out bit for bit the same.
+    EncodedVertices positionsOnly() const;
+};
+
+class VertexEncoder
+{
+public:
+    // The grid is the box positions are quantized in. Meshes sharing edges must share the grid,
+    // otherwise their common vertices may round differently and leave cracks.
+    static EncodedVertices encode(const std::vector<Vertex>& vertices, VertexFormat format, const AABB& grid);
+
+    // Unit vector to the octahedral map in [-1, 1]^2, snorm16 packed
+    static void encodeOctahedral(const glm::vec3& normal, int16_t output[2]);
+    static glm::vec3 decodeOctahedral(const int16_t input[2]);
+
+    static uint16_t toHalf(float value);
+};
@@ -11,7 +11,7 @@ static Player *player = nullptr;
 
 // Static World members
 Camera *World::camera = nullptr;
-Shader *World::material = nullptr;
+ShaderVariants *World::material = nullptr;
 LightSystem *World::lights = nullptr;
 SpotLight *World::spotLight = nullptr;
 AmbientLight *World::ambience = nullptr;
@@ -20,6 +20,7 @@ DirectionalLight *World::sunlight = nullptr;
 Model *World::coin = nullptr;
 Model *World::terrain = nullptr;
 Model *World::glass = nullptr;
+std::shared_ptr<const LoadProgress> World::progress;
 
 std::vector<Model*> World::crates;
 
@@ -31,28 +32,8 @@ void World::init()
 	player = new Player(glm::vec3(0.0f, 10.0f, 10.0f));
 	Renderer::camera = &player->camera;
 
-	material = new Shader("resources/shaders/material.vert", "resources/shaders/material.frag");
-	terrain = new Model("resources/obj/level_1.obj");
-
-    std::vector<glm::vec3> cratePositions = {
-        glm::vec3(5.0f, 1.0f, 5.0f),
-        glm::vec3(-3.0f, 1.0f, 8.0f),
-        glm::vec3(10.0f, 1.0f, -5.0f),
-        glm::vec3(-8.0f, 1.0f, -3.0f),
-        glm::vec3(15.0f, 1.0f, 10.0f),
-        glm::vec3(0.0f, 1.0f, -10.0f),
-        glm::vec3(12.0f, 1.0f, 3.0f),
-        glm::vec3(-5.0f, 1.0f, -8.0f)
-    };
-
-    for (const auto& pos : cratePositions) {
-        Model* crate = new Model("resources/obj/Crate1.obj");
-        crate->transform = glm::translate(glm::mat4(1.0f), pos);
-        crates.push_back(crate);
-    }
-
-	glass = new Model("resources/obj/glass.obj");
-	coin = new Model("resources/obj/coin.obj");
+	material = new ShaderVariants("resources/shaders/material.vert", "resources/shaders/material.frag", LightSystem::defines());
+	progress = load();
 
 	// 4. LIGHTS
 	lights = new LightSystem;
@@ -123,10 +104,18 @@ Scene World::calculate(float delta)
         }
     }
 
-    lights->calc();
+    // The player has moved the camera, everything below is culled against its frustum
+    Renderer::beginFrame();
+
+    lights->calc(Renderer::frame.view, Renderer::frame.projection);
 
 	terrain->submit(*material);
 	glass->submit(*material);
+
+    // Share one mesh, the render queue merges them into instanced draws
+    for (auto* crate : crates) {
+        crate->submit(*material);
+    }
     
     if (!coin_collected) {
 		coin->submit(*material);
@@ -135,14 +124,32 @@ Scene World::calculate(float delta)
     return Scene::SceneWorld;
 }
 
-Scene World::load(Renderer* Renderer, std::shared_ptr<int> progress)
+std::shared_ptr<const LoadProgress> World::load()
 {
-	if (*progress == 1)
-	{
-		World::init();
-		glfwSetInputMode(Renderer->window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-		return Scene::SceneWorld;
-	}
-	*progress = 1;
-	return Scene::SceneWorld;
-}
\ No newline at end of file
+	auto loading = std::make_shared<LoadProgress>();
+
+	terrain = new Model("resources/obj/level_1.obj", ImportSettings{}, loading);
+	terrain->occluder = true;
+
+    std::vector<glm::vec3> cratePositions = {
+        glm::vec3(5.0f, 1.0f, 5.0f),
+        glm::vec3(-3.0f, 1.0f, 8.0f),
+        glm::vec3(10.0f, 1.0f, -5.0f),
+        glm::vec3(-8.0f, 1.0f, -3.0f),
+        glm::vec3(15.0f, 1.0f, 10.0f),
+        glm::vec3(0.0f, 1.0f, -10.0f),
+        glm::vec3(12.0f, 1.0f, 3.0f),
+        glm::vec3(-5.0f, 1.0f, -8.0f)
+    };
+
+    for (const auto& pos : cratePositions) {
+        Model* crate = new Model("resources/obj/Crate1.obj", ImportSettings{}, loading);
+        crate->transform = glm::translate(glm::mat4(1.0f), pos);
+        crates.push_back(crate);
+    }
+
+	glass = new Model("resources/obj/glass.obj", ImportSettings{}, loading);
+	coin = new Model("resources/obj/coin.obj", ImportSettings{}, loading);
+
+	return loading;
+}
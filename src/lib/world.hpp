@@ -10,8 +10,9 @@ class World {
 public:	
 	static void init();
 	static Scene calculate(float delta);
-	static Scene load(Renderer* window, std::shared_ptr<int> progress);
-	static Shader* material;
+	static ShaderVariants* material;
+	// Models requested by init, still streaming in while not done
+	static std::shared_ptr<const LoadProgress> progress;
 
 private:
 	static Camera* camera;
@@ -24,4 +25,7 @@ private:
 	static Model* terrain;
 	static Model* glass;
 	static std::vector<Model*> crates;
+
+	// Requests every model of the level, returns before they are loaded
+	static std::shared_ptr<const LoadProgress> load();
 };
@@ -0,0 +1,59 @@
+#include "occlusion_culler.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <cstdio>
+
+/*
+    The culler runs on the CPU only, no window or GL context needed.
+    Camera at the origin looking down -z, a wall at z = -10 covering the left half of the view.
+*/
+
+static int failures = 0;
+
+static void check(bool condition, const char* what)
+{
+    if (!condition) {
+        std::printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+static AABB box(const glm::vec3& center, float halfSize)
+{
+    return AABB{ center - glm::vec3(halfSize), center + glm::vec3(halfSize) };
+}
+
+int main()
+{
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    // Reaches far past the top and bottom of the view, its right edge is the middle of the screen
+    std::vector<Vertex> wall = {
+        { glm::vec3(-20.0f, -20.0f, -10.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec2(0.0f) },
+        { glm::vec3(0.0f, -20.0f, -10.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec2(0.0f) },
+        { glm::vec3(0.0f, 20.0f, -10.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec2(0.0f) },
+        { glm::vec3(-20.0f, 20.0f, -10.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec2(0.0f) },
+    };
+    const GLuint indices[] = { 0, 1, 2, 0, 2, 3 };
+
+    OcclusionCuller culler;
+    culler.clear(projection * view);
+    culler.rasterize(wall, indices, 6, glm::mat4(1.0f));
+    culler.finish();
+
+    check(culler.isOccluded(box(glm::vec3(-5.0f, 0.0f, -20.0f), 1.0f)), "box behind the wall is culled");
+    check(!culler.isOccluded(box(glm::vec3(5.0f, 0.0f, -20.0f), 1.0f)), "box beside the wall is kept");
+    check(!culler.isOccluded(box(glm::vec3(0.0f, 0.0f, -20.0f), 1.0f)), "box across the edge of the wall is kept");
+    check(!culler.isOccluded(box(glm::vec3(-2.5f, 0.0f, -5.0f), 1.0f)), "box in front of the wall is kept");
+
+    // Moved to the other side of the camera, the wall hides nothing
+    culler.clear(projection * view);
+    culler.rasterize(wall, indices, 6, glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 20.0f)));
+    culler.finish();
+
+    check(!culler.isOccluded(box(glm::vec3(-5.0f, 0.0f, -20.0f), 1.0f)), "wall behind the camera hides nothing");
+
+    if (failures == 0) std::printf("All occlusion culler checks passed\n");
+    return failures == 0 ? 0 : 1;
+}